@@ -3,13 +3,11 @@ precision mediump float;
 // From Vertex Shader
 in vec3 vcolor;
 in vec2 vpos; // Distance from local origin
+flat in vec3 vlight; // (light_up, is_minisun, light_level)
 
 // Application data
 uniform sampler2D sampler0;
 uniform vec3 fcolor;
-uniform int light_up;
-uniform bool is_minisun;
-uniform float light_level;
 
 // Output color
 layout(location = 0) out vec4 color;
@@ -17,16 +15,16 @@ layout(location = 0) out vec4 color;
 void main() {
 	color = vec4(fcolor * vcolor, 1.0);
 	float radius = distance(vec2(0.0), vpos);
-	if (light_up == 1)
+	if (vlight.x > 0.5)
 	{
 		// 0.8 is just to make it not too strong
 		color.xyz += vec3(1.0, 1.0, 0.0);
 	}
 
-	if (is_minisun)
+	if (vlight.y > 0.5)
 	{
 		// 0.8 is just to make it not too strong
-		color.xyz += vec3(light_level * 1.0, light_level * 1.0, 0.0);
+		color.xyz += vec3(vlight.z * 1.0, vlight.z * 1.0, 0.0);
 	}
 
 }
@@ -2,16 +2,21 @@
 in vec3 in_position;
 in vec3 in_color;
 
+// Per-instance attributes
+in mat3 instance_transform;
+in vec3 instance_light; // (light_up, is_minisun, light_level)
+
 out vec3 vcolor;
 out vec2 vpos;
+flat out vec3 vlight;
 
 // Application data
-uniform mat3 transform;
 uniform mat3 projection;
 
 void main() {
 	vpos = in_position.xy; // local coordinates before transform
 	vcolor = in_color;
-	vec3 pos = projection * transform * vec3(in_position.xy, 1.0); // why not simply *in_position.xyz ?
+	vlight = instance_light;
+	vec3 pos = projection * instance_transform * vec3(in_position.xy, 1.0); // why not simply *in_position.xyz ?
 	gl_Position = vec4(pos.xy, in_position.z, 1.0);
-}
\ No newline at end of file
+}
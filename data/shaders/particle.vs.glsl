@@ -6,6 +6,7 @@ layout (location = 2) in vec2 world_pos;
 layout (location = 3) in vec2 scale;
 layout (location = 4) in vec4 in_color;
 layout (location = 5) in float angle;
+layout (location = 6) in vec4 uv_rect; // part of the (atlas) texture covered by the particle's texture
 
 // Passed to fragment shader
 out vec2 tex_coord;
@@ -44,6 +45,6 @@ void main() {
 	vec3 pos = projection * transform * vec3(in_pos, 1.0);
 
 	gl_Position = vec4(pos.xy, 0.0, 1.0);
-	tex_coord = in_tex_coord;
+	tex_coord = uv_rect.xy + (uv_rect.zw * in_tex_coord);
 	fcolor = in_color;
 }
@@ -1,8 +1,9 @@
 /**
  * Post processing shader.
- * Bloom shader code loosely adapted from https://learnopengl.com/Advanced-Lighting/Bloom
- * Many things were changed, mainly having the brightness pass and compositing stage done in the same shader.
- * Also, instead of using more render passes, I used a larger Gaussian kernel with fewer passes.
+ * Bloom is done with a mip chain: the bright parts of the world are downsampled into successively smaller targets,
+ * and then upsampled back up, adding every level onto the next larger one. The filters are the 13-tap downsample and
+ * the 3x3 tent upsample from "Next Generation Post Processing in Call of Duty: Advanced Warfare" (Jorge Jimenez,
+ * SIGGRAPH 2014), see also https://learnopengl.com/Guest-Articles/2022/Phys.-Based-Bloom
  */
 
 precision mediump float;
@@ -14,16 +15,13 @@ in vec2 texcoord;
 
 layout(location = 0) out vec4 color;
 
-// NOTE: this is not a full Gaussian kernel, but rather half of one. This is because we symmetrically
-// add/multiply 2 pixels in each loop iteration when convolving this kernel with the image.
-// thus, as a full 1d Gaussian kernel, this would actually be of size 9
-#define KERNEL_SIZE 5
+// size of a texel of input1
+uniform vec2 texel_size;
 
-const float kernel[KERNEL_SIZE] = float[](0.20416369, 0.18017382, 0.12383154, 0.06628225, 0.02763055);
+// how much of the accumulated bloom is added to the world
+uniform float bloom_strength;
 
-uniform vec2 screen_size;
-
-// shader mode, 0 = brightness pass, 1 = horizontal blur, 2 = vertical blur, 3 = composite
+// shader mode, 0 = brightness prefilter, 1 = downsample, 2 = upsample, 3 = composite
 uniform int mode;
 
 // calculate the brightness (luminance) of the given rgb pixel
@@ -31,41 +29,68 @@ float brightness(vec3 color) {
     return (0.2126 * color.r) + (0.7152 * color.g) + (0.0722 * color.b);
 }
 
-void main() {
-    if (mode == 0) {
-        vec4 tex_color = texture(input1, texcoord);
-        if (brightness(tex_color.rgb) <= 1.5) {
-            color = vec4(0.0);
-        } else {
-            color = tex_color;
-        }
-        return;
+vec3 sampleInput(vec2 offset) {
+    vec3 sample_color = texture(input1, texcoord + offset * texel_size).rgb;
+    // only the bright parts of the world bloom
+    if (mode == 0 && brightness(sample_color) <= 1.5) {
+        return vec3(0.0);
     }
+    return sample_color;
+}
+
+// 13 bilinear taps that together cover a 6x6 texel area, weighted as five overlapping 4x4 boxes
+vec3 downsample() {
+    vec3 a = sampleInput(vec2(-2.0, 2.0));
+    vec3 b = sampleInput(vec2(0.0, 2.0));
+    vec3 c = sampleInput(vec2(2.0, 2.0));
+
+    vec3 d = sampleInput(vec2(-2.0, 0.0));
+    vec3 e = sampleInput(vec2(0.0, 0.0));
+    vec3 f = sampleInput(vec2(2.0, 0.0));
+
+    vec3 g = sampleInput(vec2(-2.0, -2.0));
+    vec3 h = sampleInput(vec2(0.0, -2.0));
+    vec3 i = sampleInput(vec2(2.0, -2.0));
+
+    vec3 j = sampleInput(vec2(-1.0, 1.0));
+    vec3 k = sampleInput(vec2(1.0, 1.0));
+    vec3 l = sampleInput(vec2(-1.0, -1.0));
+    vec3 m = sampleInput(vec2(1.0, -1.0));
+
+    return e * 0.125 + (a + c + g + i) * 0.03125 + (b + d + f + h) * 0.0625 + (j + k + l + m) * 0.125;
+}
+
+// 3x3 tent filter
+vec3 upsample() {
+    vec3 a = sampleInput(vec2(-1.0, 1.0));
+    vec3 b = sampleInput(vec2(0.0, 1.0));
+    vec3 c = sampleInput(vec2(1.0, 1.0));
+
+    vec3 d = sampleInput(vec2(-1.0, 0.0));
+    vec3 e = sampleInput(vec2(0.0, 0.0));
+    vec3 f = sampleInput(vec2(1.0, 0.0));
 
+    vec3 g = sampleInput(vec2(-1.0, -1.0));
+    vec3 h = sampleInput(vec2(0.0, -1.0));
+    vec3 i = sampleInput(vec2(1.0, -1.0));
+
+    return (e * 4.0 + (b + d + f + h) * 2.0 + (a + c + g + i)) / 16.0;
+}
+
+void main() {
     if (mode == 3) {
         vec3 blurred = texture(input1, texcoord).rgb;
         vec3 scene = texture(input2, texcoord).rgb;
-        scene += blurred;
+        scene += blurred * bloom_strength;
 
         color = vec4(scene, 1.0);
         return;
     }
 
-    // else, apply blur
-    vec2 texel_size = vec2(1.0) / screen_size;
-    vec3 result = texture(input1, texcoord).rgb * kernel[0];
-
-    for (int i = 1; i < KERNEL_SIZE; i++) {
-        // as mentioned above, symmetrically apply the kernel to two pixels on either size of the central pixel, offset based on the index
-        float fi = float(i);
-        if (mode == 1) { // horizontal
-            result += texture(input1, texcoord + vec2(fi * texel_size.x, 0.0)).rgb * kernel[i];
-            result += texture(input1, texcoord - vec2(fi * texel_size.x, 0.0)).rgb * kernel[i];
-        } else if (mode == 2) { // vertical
-            result += texture(input1, texcoord + vec2(0.0, fi * texel_size.y)).rgb * kernel[i];
-            result += texture(input1, texcoord - vec2(0.0, fi * texel_size.y)).rgb * kernel[i];
-        }
+    if (mode == 2) {
+        color = vec4(upsample(), 1.0);
+        return;
     }
 
-    color = vec4(result, 1.0);
-}
\ No newline at end of file
+    color = vec4(downsample(), 1.0);
+}
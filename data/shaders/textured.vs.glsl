@@ -15,8 +15,12 @@ uniform float horizontal_offset;
 uniform float vertical_offset;
 uniform vec2 cell_size;
 
+// Part of the (atlas) texture covered by this sprite's texture, offset in xy and size in zw
+uniform vec4 uv_rect;
+
 void main() {
-	tex_coord = (cell_size * in_texcoord) + vec2(horizontal_offset, vertical_offset);
+	vec2 local_tex_coord = (cell_size * in_texcoord) + vec2(horizontal_offset, vertical_offset);
+	tex_coord = uv_rect.xy + (uv_rect.zw * local_tex_coord);
 	frag_pos = transform * vec3(in_position.xy, 1.0);
 	frag_pos.z = in_position.z;
 	vec3 pos = projection * transform * vec3(in_position.xy, 1.0);
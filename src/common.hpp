@@ -72,6 +72,14 @@ inline std::string font_path(const std::string& name) {
 inline std::string background_path(const std::string& name) {
     return data_path() + "/backgrounds/" + name;
 }
+// generated data (converted meshes, decoded textures, ...) that can be deleted at any time and will be rebuilt
+inline std::string cache_path(const std::string& name) {
+    return data_path() + "/cache/" + name;
+}
+// binary scenes and backgrounds written by raycast_scenec, loaded instead of their JSON as long as they are up to date
+inline std::string compiled_path(const std::string& name) {
+    return data_path() + "/compiled/" + name;
+}
 inline std::string player_data_path(const std::string& name) {
 #ifdef __EMSCRIPTEN__
     return "/player_data/" + std::string(name);
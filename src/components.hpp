@@ -3,6 +3,8 @@
 #include "common.hpp"
 #include "texture.hpp"
 
+#include <array>
+
 // Main data relevant to the level
 struct Scene {
     std::string scene_tag;
@@ -102,14 +104,6 @@ struct LightUp {
 
 
 // Structure to store collision information
-struct Collision {
-    // NOTE: The first object is stored in the ECS container.entities.
-    Entity other;        // The second object involved in the collision.
-    int side = 0;        // side (1 for y, 2 for x) the collision occurrs on
-    float overlap = 0.f; // amount the two objects overlap
-    explicit Collision(Entity& other) { this->other = other; };
-};
-
 struct Highlightable {
     bool isHighlighted = false;
 };
@@ -205,6 +199,8 @@ struct TextureMaterial {
     float h_offset = 0;
     float v_offset = 0;
     vec2 cell_size = {1, 1};
+    /** part of the albedo/normal textures covered by this texture, see `TextureRegion` */
+    vec4 uv_rect = {0, 0, 1, 1};
 };
 
 enum BlendMode {
@@ -315,6 +311,39 @@ struct ParticleSpawner {
     float _cooldown = 0.0f;
 };
 
+/**
+ * The fading trail behind a light ray, made of the ray's last few positions. Every point is drawn like a particle
+ * that shrinks and fades with age, but the points live in a ring buffer instead of being entities of their own.
+ * The trail has its own entity so that it can fade out after its light ray is gone.
+ */
+struct LightTrail {
+    static constexpr int POINT_COUNT = 8;
+    /** How long (in seconds) a point is drawn for */
+    static constexpr float LIFETIME = 1.0f;
+    /** Seconds between two points, so that the ring buffer is never overwritten while a point is still alive */
+    static constexpr float POINT_INTERVAL = LIFETIME / POINT_COUNT;
+    static constexpr float INITIAL_SCALE = 8.0f;
+    /** Units of scale a point loses per second, it stays centered while it shrinks */
+    static constexpr float SCALE_CHANGE = -15.0f;
+    /** How much alpha a point loses per second */
+    static constexpr float ALPHA_CHANGE = -1.7f;
+
+    /** The light ray leaving this trail, it may not exist anymore */
+    Entity light;
+    VirtualTextureHandle texture = 0;
+    /** Color of new points, color AND alpha channels are in range [0, 1] */
+    vec4 color = vec4(1.7, 1.7, 0, 1);
+
+    /** Top left corner of the ray when each point was left behind */
+    std::array<vec2, POINT_COUNT> positions = {};
+    /** Age of each point in seconds, points are dead once they reach `LIFETIME` */
+    std::array<float, POINT_COUNT> ages = {};
+    int next_point = 0;
+    float cooldown = 0.0f;
+
+    explicit LightTrail(const Entity& light) : light(light) { ages.fill(LIFETIME); }
+};
+
 /**
  * This is used more as a general purpose helper for constructing more complex objects like sprites.
  * Not a component in its own right.
@@ -413,6 +442,8 @@ struct ColoredVertex {
 };
 
 struct Mesh {
+    // path of the mesh file this was loaded from, shared by every entity using the same mesh
+    std::string name;
     vec2 original_size = {1, 1};
     std::vector<ColoredVertex> vertices;
     std::vector<uint16_t> vertex_indices;
@@ -441,6 +472,39 @@ struct Setting {
     float position_y;
 };
 
+// Scene file entries that don't map to a single component, but to one of the `create*` helpers in world_init
+struct SpriteSheetRecord {
+    SpriteSheet sheet;
+    std::string texture;
+    float image_width = 0;
+    float image_height = 0;
+};
+
+struct LeverRecord {
+    vec2 position = {0, 0};
+    LEVER_STATES state = LEVER_STATES::LEFT;
+    LEVER_EFFECTS effect = LEVER_EFFECTS::NONE;
+    LEVER_STATES active_lever = LEVER_STATES::LEFT;
+};
+
+struct MeshRecord {
+    std::string path;
+    vec2 position = {0, 0};
+    float angle = 0;
+    vec2 scale = {1, 1};
+};
+
+struct BackgroundRecord {
+    std::string id;
+};
+
+struct PortalPairRecord {
+    vec2 position = {0, 0};
+    float angle = 0;
+    vec2 other_position = {0, 0};
+    float other_angle = 0;
+};
+
 struct Invisible {
 
 };
\ No newline at end of file
@@ -1,10 +1,19 @@
 #pragma once
 
 #include "components.hpp"
+#include "components_list.hpp"
 #include "json.hpp"
 
 using json = nlohmann::json;
 
+/**
+ * The value of the "type" key of scene file entries parsed into `T`.
+ */
+template <typename T> constexpr const char* scene_type_name = nullptr;
+#define SCENE_TYPE_NAME(name, ty) template <> constexpr const char* scene_type_name<ty> = name;
+RAYCAST_SCENE_COMPONENTS(SCENE_TYPE_NAME)
+#undef SCENE_TYPE_NAME
+
 /**
  * Defines the JSON serializer/deserialzer for the third-party GLM vec2 and vec3
  * types. Read more here: https://json.nlohmann.me/features/arbitrary_types/
@@ -49,7 +58,7 @@ template <> struct nlohmann::adl_serializer<vec4> {
 
 // ChangeScene
 inline void to_json(json& j, const ChangeScene& c) {
-    j = json{{"type", "change_scene"}, {"scene", c.scene}};
+    j = json{{"type", scene_type_name<ChangeScene>}, {"scene", c.scene}};
 }
 
 inline void from_json(const json& j, ChangeScene& c) { j.at("scene").get_to(c.scene); }
@@ -57,7 +66,7 @@ inline void from_json(const json& j, ChangeScene& c) { j.at("scene").get_to(c.sc
 // Zone
 inline void to_json(json& j, const Zone& c) {
     j = json{
-        {"type", "zone"},
+        {"type", scene_type_name<Zone>},
         {"position", c.position},
         {"zone_type", static_cast<ZONE_TYPE>(c.type)},
         {"mass", c.mass},
@@ -74,7 +83,7 @@ inline void from_json(const json& j, Zone& c) {
 
 // LightSource
 inline void to_json(json& j, const LightSource& c) {
-    j = json{{"type", "light_source"}, {"angle", (float)c.angle}};
+    j = json{{"type", scene_type_name<LightSource>}, {"angle", (float)c.angle}};
 }
 inline void from_json(const json& j, LightSource& c) { j.at("angle").get_to(c.angle); }
 
@@ -91,7 +100,7 @@ inline void to_json(json& j, const Lerpable& lr) {
 }
 
 inline void to_json(json& j, const Level& c) {
-    j = json{ {"type", "level"}, {"id", c.id}, {"name", c.name} };
+    j = json{ {"type", scene_type_name<Level>}, {"id", c.id}, {"name", c.name} };
 }
 
 inline void from_json(const json& j, Level& c) {
@@ -100,7 +109,7 @@ inline void from_json(const json& j, Level& c) {
 }
 
 inline void to_json(json& j, const EndLevel& c) {
-    j = json{ {"type", "end_level"}, {"id", c.id} };
+    j = json{ {"type", scene_type_name<EndLevel>}, {"id", c.id} };
 }
 
 inline void from_json(const json& j, EndLevel& c) {
@@ -109,7 +118,7 @@ inline void from_json(const json& j, EndLevel& c) {
 
 inline void to_json(json& j, const Reflective& c) {
     (void)c;
-    j = json{{"type", "light_source"}};
+    j = json{{"type", scene_type_name<Reflective>}};
 }
 
 inline void from_json(const json& j, Reflective& c) {
@@ -120,7 +129,7 @@ inline void from_json(const json& j, Reflective& c) {
 
 inline void to_json(json& j, const LevelSelect& c) {
     (void)c;
-    j = json{{"type", "level_select"}};
+    j = json{{"type", scene_type_name<LevelSelect>}};
 }
 
 inline void from_json(const json& j, LevelSelect& c) {
@@ -129,7 +138,7 @@ inline void from_json(const json& j, LevelSelect& c) {
 }
 
 inline void to_json(json& j, const Sprite& c) {
-    j = json{ {"type", "sprite"}, {"position", c.position}, {"scale", c.scale}, {"angle", c.angle}, {"texture", c.texture} };
+    j = json{ {"type", scene_type_name<Sprite>}, {"position", c.position}, {"scale", c.scale}, {"angle", c.angle}, {"texture", c.texture} };
 }
 
 inline void from_json(const json& j, Sprite& c) {
@@ -154,7 +163,7 @@ inline void from_json(const json& j, Sprite& c) {
 
 inline void to_json(json& j, const Mirror& c) {
     j = json{
-        {"type", "mirror"},
+        {"type", scene_type_name<Mirror>},
         {"position", c.position},
         {"angle", c.angle},
         {"mirror-type", c.mirrorType},
@@ -216,7 +225,7 @@ inline void from_json(const json& j, PointLight& c) {
 }
 
 inline void to_json(json& j, const Highlightable& c) {
-    j = json{{"type", "highlightable"}, {"isHighlighted", c.isHighlighted}};
+    j = json{{"type", scene_type_name<Highlightable>}, {"isHighlighted", c.isHighlighted}};
 }
 
 inline void from_json(const json& j, Highlightable& c) {
@@ -224,7 +233,7 @@ inline void from_json(const json& j, Highlightable& c) {
 }
 
 inline void to_json(json& j, const DashTheTurtle& c) {
-    j = json{{"type", "dashTheTurtle"},
+    j = json{{"type", scene_type_name<DashTheTurtle>},
              {"behavior", c.behavior},
              {"minimumDisplacement", c.nearestLightRayDirection},
              {"originalPosition", c.originalPosition}};
@@ -254,7 +263,7 @@ inline void from_json(const json& j, Motion& c) {
 }
 
 inline void to_json(json& j, const ButtonHelper& c) {
-    j = json{{"type", "button"}, {"position", c.position}, {"scale", c.scale}, {"label", c.label}};
+    j = json{{"type", scene_type_name<ButtonHelper>}, {"position", c.position}, {"scale", c.scale}, {"label", c.label}};
 }
 
 inline void from_json(const json& j, ButtonHelper& c) {
@@ -264,7 +273,7 @@ inline void from_json(const json& j, ButtonHelper& c) {
 }
 
 inline void to_json(json& j, const Collider& c) {
-    j = json{{{"type", "collider"},
+    j = json{{{"type", scene_type_name<Collider>},
         {"bounds", c.bounds_type},
         {"width"}, c.width},
         {"height", c.height}
@@ -280,7 +289,7 @@ inline void from_json(const json& j, Collider& c) {
 // Collideable
 inline void to_json(json& j, const Collideable& c) {
     (void)c;
-    j = json{{"type", "collideable"}};
+    j = json{{"type", scene_type_name<Collideable>}};
 }
 inline void from_json(const json& j, Collideable& c) {
     (void)j;
@@ -290,7 +299,7 @@ inline void from_json(const json& j, Collideable& c) {
 // Interactable
 inline void to_json(json& j, const Interactable& c) {
     (void)c;
-    j = json{{"type", "interactable"}};
+    j = json{{"type", scene_type_name<Interactable>}};
 }
 
 inline void from_json(const json& j, Interactable& c) {
@@ -301,7 +310,7 @@ inline void from_json(const json& j, Interactable& c) {
 // Blackhole 
 inline void to_json(json& j, const Blackhole& bh) {
     j = json{
-        {"type", "blackhole"},
+        {"type", scene_type_name<Blackhole>},
         {"mass", bh.mass},
         {"schwarzchild_radius", bh.schwarzchild_radius}
     };
@@ -333,7 +342,7 @@ inline void from_json(const json& j, SpriteSheet& c) {
 }
 
 inline void to_json(json& j, const MiniSun& c) {
-    j = json{{"type", "minisun"},
+    j = json{{"type", scene_type_name<MiniSun>},
              {"lit", c.lit},
              {"lit_duration", c.lit_duration}};
 }
@@ -345,7 +354,7 @@ inline void from_json(const json& j, MiniSun& c) {
 
 inline void to_json(json& j, const Text& c) {
     j = json{
-        {"type", "text"},
+        {"type", scene_type_name<Text>},
         {"position", c.position},
         {"size", c.size},
         {"text", c.text },
@@ -366,7 +375,7 @@ inline void from_json(const json& j, Text& c) {
 
 inline void to_json(json& j, const MenuItem& c) {
     (void)c;
-    j = json{{"type", "menu_item"}};
+    j = json{{"type", scene_type_name<MenuItem>}};
 }
 
 inline void from_json(const json& j, MenuItem& c) {
@@ -376,7 +385,7 @@ inline void from_json(const json& j, MenuItem& c) {
 
 inline void to_json(json& j, const Gravity& c) {
     (void)c;
-    j = json{{"type", "gravity"}};
+    j = json{{"type", scene_type_name<Gravity>}};
 }
 
 inline void from_json(const json& j, Gravity& c) {
@@ -386,7 +395,7 @@ inline void from_json(const json& j, Gravity& c) {
 
 inline void to_json(json& j, const DeleteData& c) {
     (void)c;
-    j = json{{"type", "delete_data"}};
+    j = json{{"type", scene_type_name<DeleteData>}};
 }
 
 inline void from_json(const json& j, DeleteData& c) {
@@ -395,7 +404,7 @@ inline void from_json(const json& j, DeleteData& c) {
 }
 
 inline void to_json(json& j, const EndCutsceneCount& c) {
-    j = json{{"type", "end_cutscene_count"}, {"position", c.position}, {"maxInclusive", c.maxInclusive}};
+    j = json{{"type", scene_type_name<EndCutsceneCount>}, {"position", c.position}, {"maxInclusive", c.maxInclusive}};
 }
 
 inline void from_json(const json& j, EndCutsceneCount& c) {
@@ -407,7 +416,7 @@ inline void from_json(const json& j, EndCutsceneCount& c) {
 
 inline void to_json(json& j, const AmbientLight& c) {
     j = json {
-        {"type", "ambient_light"},
+        {"type", scene_type_name<AmbientLight>},
         {"color", c.color},
     };
 }
@@ -417,10 +426,40 @@ inline void from_json(const json& j, AmbientLight& c) {
 }
 
 inline void to_json(json& j, const Setting& c) {
-    j = json{{"type", "setting"}, {"setting", c.setting}, {"position_y", c.position_y}};
+    j = json{{"type", scene_type_name<Setting>}, {"setting", c.setting}, {"position_y", c.position_y}};
 }
 
 inline void from_json(const json& j, Setting& c) {
     j.at("setting").get_to(c.setting);
     j.at("position_y").get_to(c.position_y);
 }
+
+inline void from_json(const json& j, SpriteSheetRecord& c) {
+    j.get_to(c.sheet);
+    j.at("texture").get_to(c.texture);
+    j.at("imageWidth").get_to(c.image_width);
+    j.at("imageHeight").get_to(c.image_height);
+}
+
+inline void from_json(const json& j, LeverRecord& c) {
+    j.at("position").get_to(c.position);
+    j.at("state").get_to(c.state);
+    j.at("effect").get_to(c.effect);
+    j.at("activeLever").get_to(c.active_lever);
+}
+
+inline void from_json(const json& j, MeshRecord& c) {
+    j.at("path").get_to(c.path);
+    j.at("position").get_to(c.position);
+    j.at("angle").get_to(c.angle);
+    j.at("scale").get_to(c.scale);
+}
+
+inline void from_json(const json& j, BackgroundRecord& c) { j.at("id").get_to(c.id); }
+
+inline void from_json(const json& j, PortalPairRecord& c) {
+    j.at("portal_position").get_to(c.position);
+    j.at("portal_angle").get_to(c.angle);
+    j.at("other_portal_position").get_to(c.other_position);
+    j.at("other_portal_angle").get_to(c.other_angle);
+}
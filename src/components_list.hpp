@@ -0,0 +1,94 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////
+///
+/// The lists of components the rest of the code is generated from, as X-macros: every list calls the macro passed
+/// to it once per component. To add a component, add it here instead of to each of the places these lists are used.
+///
+////////////////////////////////////////////////////////////////
+
+/**
+ * Every component container in `ECSRegistry`, as X(Type, container).
+ */
+#define RAYCAST_COMPONENTS(X)                                                  \
+    X(Scene, scenes)                                                           \
+    X(Motion, motions)                                                         \
+    X(Interactable, interactables)                                             \
+    X(ChangeScene, changeScenes)                                               \
+    X(VolumeSlider, volumeSliders)                                             \
+    X(Toggle, toggles)                                                         \
+    X(ResumeGame, resumeGames)                                                 \
+    X(Zone, zones)                                                             \
+    X(LightSource, lightSources)                                               \
+    X(Light, lightRays)                                                        \
+    X(Material, materials)                                                     \
+    X(PointLight, pointLights)                                                 \
+    X(Reflective, reflectives)                                                 \
+    X(Level, levels)                                                           \
+    X(OnLinearRails, entitiesOnLinearRails)                                    \
+    X(Lerpable, lerpables)                                                     \
+    X(Rotatable, rotatable)                                                    \
+    X(Highlightable, highlightables)                                           \
+    X(Collider, colliders)                                                     \
+    X(Collideable, collideables)                                               \
+    X(Menu, menus)                                                             \
+    X(MenuItem, menuItems)                                                     \
+    X(LevelSelect, levelSelects)                                               \
+    X(DashTheTurtle, turtles)                                                  \
+    X(ButtonFlag, buttons)                                                     \
+    X(Text, texts)                                                             \
+    X(Mouse, mice)                                                             \
+    X(Blackhole, blackholes)                                                   \
+    X(SpriteSheet, spriteSheets)                                               \
+    X(MiniSun, minisuns)                                                       \
+    X(Gravity, gravities)                                                      \
+    X(Lever, levers)                                                           \
+    X(Particle, particles)                                                     \
+    X(ParticleSpawner, particleSpawners)                                       \
+    X(LightTrail, lightTrails)                                                 \
+    X(Mesh, meshes)                                                            \
+    X(LightUp, litEntities)                                                    \
+    X(DeleteData, deleteDatas)                                                 \
+    X(InOrbit, inOrbits)                                                       \
+    X(Portal, portals)                                                         \
+    X(EndLevel, endLevels)                                                     \
+    X(EndCutsceneCount, endCutsceneCounts)                                     \
+    X(AmbientLight, ambientLights)                                             \
+    X(Invisible, invisibles)
+
+/**
+ * Every entry a scene file can contain, as X("type", Type), where "type" is the value of the entry's "type" key and
+ * `Type` what it is parsed into. Entries whose type has a container in `ECSRegistry` are added to it as they are,
+ * the others are handled by `SceneReplay` (see scenes.cpp).
+ */
+#define RAYCAST_SCENE_COMPONENTS(X)                                            \
+    X("sprite", Sprite)                                                        \
+    X("change_scene", ChangeScene)                                             \
+    X("zone", Zone)                                                            \
+    X("light_source", LightSource)                                             \
+    X("lerpable", Lerpable)                                                    \
+    X("reflective", Reflective)                                                \
+    X("level", Level)                                                          \
+    X("mirror", Mirror)                                                        \
+    X("highlightable", Highlightable)                                          \
+    X("level_select", LevelSelect)                                             \
+    X("dash_the_turtle", DashTheTurtle)                                        \
+    X("button", ButtonHelper)                                                  \
+    X("collider", Collider)                                                    \
+    X("collideable", Collideable)                                              \
+    X("interactable", Interactable)                                            \
+    X("blackhole", Blackhole)                                                  \
+    X("sprite_sheet", SpriteSheetRecord)                                       \
+    X("minisun", MiniSun)                                                      \
+    X("gravity", Gravity)                                                      \
+    X("menu_item", MenuItem)                                                   \
+    X("text", Text)                                                            \
+    X("lever", LeverRecord)                                                    \
+    X("mesh", MeshRecord)                                                      \
+    X("delete_data", DeleteData)                                               \
+    X("background", BackgroundRecord)                                          \
+    X("portal_pair", PortalPairRecord)                                         \
+    X("end_level", EndLevel)                                                   \
+    X("end_cutscene_count", EndCutsceneCount)                                  \
+    X("ambient_light", AmbientLight)                                           \
+    X("setting", Setting)
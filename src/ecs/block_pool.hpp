@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+// Heap traffic of all component containers, for profiling. Containers are
+// only used from the main thread, so these are plain counters.
+struct ContainerAllocationStats {
+    // Chunks allocated by pools, and allocations that don't fit a pool
+    size_t heap_allocations = 0;
+    // Times the component vector of a container had to grow
+    size_t vector_growths = 0;
+    // Memory held by all pools
+    size_t pooled_bytes = 0;
+};
+
+inline ContainerAllocationStats container_allocation_stats;
+
+// Hands out blocks of a single size from large chunks, and keeps freed blocks
+// in a free list to hand them out again. Chunks are only released when the
+// pool is destroyed, so once a container held a number of components, holding
+// that many again doesn't touch the heap. The block size is picked by the
+// first single object allocation, which for a hash map is its first node.
+class BlockPool {
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    static constexpr size_t MIN_CHUNK_BLOCKS = 64;
+
+    size_t block_size = 0;
+    size_t capacity = 0;
+    size_t reserved = 0;
+    FreeBlock* free_list = nullptr;
+    std::vector<std::unique_ptr<std::byte[]>> chunks;
+
+    void allocate_chunk(size_t blocks) {
+        chunks.emplace_back(new std::byte[blocks * block_size]);
+        std::byte* chunk = chunks.back().get();
+        for (size_t i = blocks; i-- > 0;) {
+            free_list = new (chunk + i * block_size) FreeBlock{free_list};
+        }
+        capacity += blocks;
+        container_allocation_stats.heap_allocations++;
+        container_allocation_stats.pooled_bytes += blocks * block_size;
+    }
+
+  public:
+    BlockPool() = default;
+    BlockPool(const BlockPool&) = delete;
+    BlockPool& operator=(const BlockPool&) = delete;
+
+    ~BlockPool() { container_allocation_stats.pooled_bytes -= capacity * block_size; }
+
+    // Whether allocations of the given size come from this pool
+    bool fits(size_t size) {
+        // blocks are aligned like anything new[] returns
+        size = (size + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+        if (block_size == 0) {
+            block_size = std::max(size, sizeof(FreeBlock));
+        }
+        return size == block_size;
+    }
+
+    // Only call with a size `fits` returned true for
+    void* allocate() {
+        if (free_list == nullptr) {
+            allocate_chunk(std::max(MIN_CHUNK_BLOCKS, reserved > capacity ? reserved - capacity : capacity));
+        }
+        FreeBlock* block = free_list;
+        free_list = block->next;
+        return block;
+    }
+
+    void deallocate(void* block) { free_list = new (block) FreeBlock{free_list}; }
+
+    // Make sure the pool has room for the given number of blocks in total, in
+    // as few chunks as possible
+    void reserve(size_t blocks) {
+        reserved = std::max(reserved, blocks);
+        if (block_size != 0 && reserved > capacity) {
+            allocate_chunk(reserved - capacity);
+        }
+    }
+};
+
+// Standard allocator that takes single objects from a `BlockPool`, and
+// everything else (such as the bucket array of a hash map) from the heap.
+template <typename T> class PoolAllocator {
+    template <typename U> friend class PoolAllocator;
+
+    BlockPool* pool;
+
+  public:
+    using value_type = T;
+
+    explicit PoolAllocator(BlockPool& pool_arg) : pool(&pool_arg) {}
+
+    template <typename U> PoolAllocator(const PoolAllocator<U>& other) : pool(other.pool) {}
+
+    T* allocate(size_t n) {
+        static_assert(alignof(T) <= alignof(std::max_align_t));
+        if (n == 1 && pool->fits(sizeof(T))) {
+            return static_cast<T*>(pool->allocate());
+        }
+        container_allocation_stats.heap_allocations++;
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n) {
+        if (n == 1 && pool->fits(sizeof(T))) {
+            pool->deallocate(p);
+        } else {
+            ::operator delete(p);
+        }
+    }
+
+    template <typename U> bool operator==(const PoolAllocator<U>& other) const { return pool == other.pool; }
+    template <typename U> bool operator!=(const PoolAllocator<U>& other) const { return pool != other.pool; }
+};
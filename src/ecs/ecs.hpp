@@ -6,7 +6,9 @@
 #include <set>
 #include <typeindex>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
+#include "block_pool.hpp"
 #include "logging/log.hpp"
 
 // Unique identifier for all entities
@@ -24,15 +26,17 @@ class Entity {
         return id;
     } // this enables automatic casting to int
 
-    // fix copy constructor issues
-    Entity(const Entity &other) {
-        id = other.id;
-    }
+    // fix copy constructor issues, copying an entity only copies its id and
+    // never allocates a new one (defaulted so entities are trivially copyable)
+    Entity(const Entity &other) = default;
+    Entity &operator=(const Entity &other) = default;
 };
 
 // Common interface to refer to all containers in the ECS registry
 struct ContainerInterface {
     virtual void clear() = 0;
+    virtual void retain(const std::unordered_set<unsigned int>& kept) = 0;
+    virtual void reserve(size_t count) = 0;
     virtual size_t size() = 0;
     virtual void remove(Entity e) = 0;
     virtual bool has(Entity entity) = 0;
@@ -43,9 +47,17 @@ struct ContainerInterface {
 template <typename Component> // A component can be any class
 class ComponentContainer : public ContainerInterface {
   private:
+    // The nodes of `map_entity_componentID`, reused as components come and
+    // go instead of allocating every one of them on the heap. Declared before
+    // the map so that it outlives it.
+    BlockPool map_nodes;
+
+    using EntityMap = std::unordered_map<unsigned int, unsigned int, std::hash<unsigned int>,
+                                         std::equal_to<unsigned int>,
+                                         PoolAllocator<std::pair<const unsigned int, unsigned int>>>;
+
     // The hash map from Entity -> array index.
-    std::unordered_map<unsigned int, unsigned int>
-        map_entity_componentID; // the entity is cast to uint to be hashable.
+    EntityMap map_entity_componentID{0, EntityMap::allocator_type(map_nodes)}; // the entity is cast to uint to be hashable.
     bool registered = false;
 
   public:
@@ -65,6 +77,8 @@ class ComponentContainer : public ContainerInterface {
         assert(!(check_for_duplicates && has(e)) &&
                "Entity already contained in ECS registry");
 
+        if (components.size() == components.capacity())
+            container_allocation_stats.vector_growths++;
         map_entity_componentID[e] = (unsigned int)components.size();
         components.push_back(
             std::move(c)); // the move enforces move instead of copy constructor
@@ -120,6 +134,41 @@ class ComponentContainer : public ContainerInterface {
         entities.clear();
     }
 
+    // Remove the components of all entities except the kept ones. The
+    // remaining components keep their order, and like `clear` this keeps the
+    // memory of the container around to be filled again.
+    void retain(const std::unordered_set<unsigned int>& kept) {
+        size_t count = 0;
+        for (size_t i = 0; i < components.size(); i++) {
+            if (kept.count(entities[i]) == 0)
+                continue;
+            if (count != i) {
+                components[count] = std::move(components[i]);
+                entities[count] = entities[i];
+            }
+            count++;
+        }
+        if (count == components.size())
+            return;
+
+        components.erase(components.begin() + count, components.end());
+        entities.erase(entities.begin() + count, entities.end());
+        map_entity_componentID.clear();
+        for (unsigned int i = 0; i < entities.size(); i++)
+            map_entity_componentID[entities[i]] = i;
+    }
+
+    // Make room for the given number of components in total, so that adding
+    // that many doesn't allocate
+    void reserve(size_t count) {
+        if (count > components.capacity())
+            container_allocation_stats.vector_growths++;
+        components.reserve(count);
+        entities.reserve(count);
+        map_entity_componentID.reserve(count);
+        map_nodes.reserve(count);
+    }
+
     // Report the number of components of type 'Component'
     size_t size() { return components.size(); }
 
@@ -128,6 +177,12 @@ class ComponentContainer : public ContainerInterface {
     template <class Compare> void sort(Compare comparisonFunction) {
         // First sort the entity list as desired
         std::sort(entities.begin(), entities.end(), comparisonFunction);
+        arrange_components_like_entities();
+    }
+
+    // Move the components into the order of the (already rearranged) entity
+    // list, see `sort`
+    void arrange_components_like_entities() {
         // Now re-arrange the components (Note, creates a new vector, which may
         // be slow! Not sure if in-place could be faster:
         // https://stackoverflow.com/questions/63703637/how-to-efficiently-permute-an-array-in-place-using-stdswap)
@@ -146,4 +201,36 @@ class ComponentContainer : public ContainerInterface {
         for (unsigned int i = 0; i < entities.size(); i++)
             map_entity_componentID[entities[i]] = i;
     }
+
+    // Sort the components in place by comparing them directly. Meant for
+    // containers that stay (almost) sorted between calls: an already sorted
+    // container is only compared once per element, and every out of place
+    // component is rotated into place without allocating. Equal components
+    // keep their order. Falls back to a full stable sort when too much is
+    // out of order.
+    template <class Compare> void sort_incremental(Compare comparisonFunction) {
+        const size_t MAX_INSERTIONS = 64;
+        size_t out_of_order = 0;
+        for (size_t i = 1; i < components.size(); i++) {
+            if (comparisonFunction(components[i], components[i - 1]) && ++out_of_order > MAX_INSERTIONS) {
+                std::stable_sort(entities.begin(), entities.end(), [&](const Entity& e1, const Entity& e2) {
+                    return comparisonFunction(get(e1), get(e2));
+                });
+                arrange_components_like_entities();
+                return;
+            }
+        }
+
+        for (size_t i = 1; out_of_order > 0 && i < components.size(); i++) {
+            if (!comparisonFunction(components[i], components[i - 1]))
+                continue;
+            const size_t target =
+                std::upper_bound(components.begin(), components.begin() + i, components[i], comparisonFunction) -
+                components.begin();
+            std::rotate(components.begin() + target, components.begin() + i, components.begin() + i + 1);
+            std::rotate(entities.begin() + target, entities.begin() + i, entities.begin() + i + 1);
+            for (size_t j = target; j <= i; j++)
+                map_entity_componentID[entities[j]] = (unsigned int)j;
+        }
+    }
 };
@@ -1,6 +1,7 @@
 #pragma once
 #include <vector>
 #include "components.hpp"
+#include "components_list.hpp"
 #include "ecs.hpp"
 #include "logging/log.hpp"
 
@@ -9,101 +10,21 @@ class ECSRegistry {
     std::vector<ContainerInterface*> registry_list;
 
   public:
-    // Manually created list of all components this game has
-    ComponentContainer<Scene> scenes;
-    ComponentContainer<Motion> motions;
-    ComponentContainer<Collision> collisions;
-    ComponentContainer<Interactable> interactables;
-    ComponentContainer<ChangeScene> changeScenes;
-    ComponentContainer<VolumeSlider> volumeSliders;
-    ComponentContainer<Toggle> toggles;
-    ComponentContainer<ResumeGame> resumeGames;
-    ComponentContainer<Zone> zones;
-    ComponentContainer<LightSource> lightSources;
-    ComponentContainer<Light> lightRays;
-    ComponentContainer<Material> materials;
-    ComponentContainer<PointLight> pointLights;
-    ComponentContainer<Reflective> reflectives;
-    ComponentContainer<Level> levels;
-    ComponentContainer<OnLinearRails> entitiesOnLinearRails;
-    ComponentContainer<Lerpable> lerpables;
-    ComponentContainer<Rotatable> rotatable;
-    ComponentContainer<Highlightable> highlightables;
-    ComponentContainer<Collider> colliders;
-    ComponentContainer<Collideable> collideables;
-    ComponentContainer<Menu> menus;
-    ComponentContainer<MenuItem> menuItems;
-    ComponentContainer<LevelSelect> levelSelects;
-    ComponentContainer<DashTheTurtle> turtles;
-    ComponentContainer<ButtonFlag> buttons;
-    ComponentContainer<Text> texts;
-    ComponentContainer<Mouse> mice;
-    ComponentContainer<Blackhole> blackholes;
-    ComponentContainer<SpriteSheet> spriteSheets;
-    ComponentContainer<MiniSun> minisuns;
-    ComponentContainer<Gravity> gravities;
-    ComponentContainer<Lever> levers;
-    ComponentContainer<Particle> particles;
-    ComponentContainer<ParticleSpawner> particleSpawners;
-    ComponentContainer<Mesh> meshes;
-    ComponentContainer<LightUp> litEntities;
-    ComponentContainer<DeleteData> deleteDatas;
-    ComponentContainer<InOrbit> inOrbits;
-    ComponentContainer<Portal> portals;
-    ComponentContainer<EndLevel> endLevels;
-    ComponentContainer<EndCutsceneCount> endCutsceneCounts;
-    ComponentContainer<AmbientLight> ambientLights;
-    ComponentContainer<Invisible> invisibles;
+    // All components this game has, see components_list.hpp
+#define DECLARE_CONTAINER(ty, container) ComponentContainer<ty> container;
+    RAYCAST_COMPONENTS(DECLARE_CONTAINER)
+#undef DECLARE_CONTAINER
 
     // constructor that adds all containers for looping over them
-    // IMPORTANT: Don't forget to add any newly added containers!
     ECSRegistry() {
-        registry_list.push_back(&scenes);
-        registry_list.push_back(&motions);
-        registry_list.push_back(&collisions);
-        registry_list.push_back(&interactables);
-        registry_list.push_back(&changeScenes);
-        registry_list.push_back(&volumeSliders);
-        registry_list.push_back(&toggles);
-        registry_list.push_back(&resumeGames);
-        registry_list.push_back(&zones);
-        registry_list.push_back(&lightSources);
-        registry_list.push_back(&lightRays);
-        registry_list.push_back(&materials);
-        registry_list.push_back(&pointLights);
-        registry_list.push_back(&reflectives);
-        registry_list.push_back(&levels);
-        registry_list.push_back(&entitiesOnLinearRails);
-        registry_list.push_back(&lerpables);
-        registry_list.push_back(&rotatable);
-        registry_list.push_back(&highlightables);
-        registry_list.push_back(&colliders);
-        registry_list.push_back(&collideables);
-        registry_list.push_back(&menus);
-        registry_list.push_back(&menuItems);
-        registry_list.push_back(&levelSelects);
-        registry_list.push_back(&turtles);
-        registry_list.push_back(&buttons);
-        registry_list.push_back(&texts);
-        registry_list.push_back(&mice);
-        registry_list.push_back(&blackholes);
-        registry_list.push_back(&spriteSheets);
-        registry_list.push_back(&minisuns);
-        registry_list.push_back(&gravities);
-        registry_list.push_back(&levers);
-        registry_list.push_back(&particles);
-        registry_list.push_back(&particleSpawners);
-        registry_list.push_back(&meshes);
-        registry_list.push_back(&litEntities);
-        registry_list.push_back(&deleteDatas);
-        registry_list.push_back(&inOrbits);
-        registry_list.push_back(&portals);
-        registry_list.push_back(&endLevels);
-        registry_list.push_back(&endCutsceneCounts);
-        registry_list.push_back(&ambientLights);
-        registry_list.push_back(&invisibles);
+#define REGISTER_CONTAINER(ty, container) registry_list.push_back(&container);
+        RAYCAST_COMPONENTS(REGISTER_CONTAINER)
+#undef REGISTER_CONTAINER
     }
 
+    // The container holding components of type `T`
+    template <typename T> ComponentContainer<T>& get();
+
     void clear_all_components() {
         for (ContainerInterface* reg : registry_list)
             if (reg != &scenes) {
@@ -111,6 +32,33 @@ class ECSRegistry {
             }
     }
 
+    // Like `clear_all_components`, but the given entities keep their
+    // components. Used to carry over the entities two scenes have in common.
+    void clear_all_components_except(const std::vector<Entity>& kept) {
+        const std::unordered_set<unsigned int> kept_ids(kept.begin(), kept.end());
+        for (ContainerInterface* reg : registry_list)
+            if (reg != &scenes) {
+                reg->retain(kept_ids);
+            }
+    }
+
+    // The number of components in every container, in the order of
+    // `RAYCAST_COMPONENTS`
+    std::vector<uint32_t> component_counts() const {
+        std::vector<uint32_t> counts;
+        counts.reserve(registry_list.size());
+        for (ContainerInterface* reg : registry_list)
+            counts.push_back((uint32_t)reg->size());
+        return counts;
+    }
+
+    // Make room for the given number of components in every container, see
+    // `component_counts`
+    void reserve(const std::vector<uint32_t>& counts) {
+        for (size_t i = 0; i < registry_list.size() && i < counts.size(); i++)
+            registry_list[i]->reserve(counts[i]);
+    }
+
     void list_all_components() const {
         LOG_INFO("Debug info on all registry entries:");
         for (ContainerInterface* reg : registry_list)
@@ -132,4 +80,9 @@ class ECSRegistry {
     }
 };
 
+#define DEFINE_CONTAINER_GETTER(ty, container)                                                                         \
+    template <> inline ComponentContainer<ty>& ECSRegistry::get<ty>() { return container; }
+RAYCAST_COMPONENTS(DEFINE_CONTAINER_GETTER)
+#undef DEFINE_CONTAINER_GETTER
+
 extern ECSRegistry registry;
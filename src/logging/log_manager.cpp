@@ -9,11 +9,11 @@ namespace logging {
  * Initializes our spdlog logger instance. spdlog has the concept of "sinks",
  * which are targets for log output (i.e files, stdout, stderr, etc.). The
  * current default "RaycastLogger" is configured to log to stdout and a log
- * file. Notice that we use stdout_color_sink_st, (st meaning single-threaded)
- * since I do not expect to have multi-threaded code yet.
+ * file. Notice that we use stdout_color_sink_mt, (mt meaning multi-threaded)
+ * since background workers (e.g. texture decoding) log as well.
  */
 void LogManager::Initialize() {
-    auto consoleSink = std::make_shared<spdlog::sinks::stdout_color_sink_st>();
+    auto consoleSink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
     consoleSink->set_pattern("[%Y-%m-%d %H:%M:%S.%e %^%l%$][%s %!] %v");
     std::vector<spdlog::sink_ptr> sinks{consoleSink};
     auto logger = std::make_shared<spdlog::logger>(RAYCAST_DEFAULT_LOGGER_NAME,
@@ -5,10 +5,14 @@
 #include "particles.hpp"
 #include "systems/ai.hpp"
 #include "systems/physics.hpp"
+#include "systems/render/headless_context.hpp"
 #include "systems/render/render.hpp"
+#include "systems/sounds.hpp"
 #include "systems/world.hpp"
 #include <chrono>
+#include <filesystem>
 #include <iostream>
+#include <string>
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
@@ -21,10 +25,30 @@ using Clock = std::chrono::high_resolution_clock;
 
 #define FIXED_UPDATE_MS 2
 
+// how long to wait for input when nothing changed on screen, there is no vsync to pace those frames
+#define IDLE_FRAME_S (1.0 / 60.0)
+
+// frame time of headless runs, a fixed time step makes every run render the same frames
+#define HEADLESS_FRAME_MS (1000.f / 60.f)
+
 bool window_focused = true;
 
 GLFWwindow* window;
 
+/**
+ * Options for rendering without a window, e.g. `raycast --headless --frames 600 --capture out --capture-every 60`
+ */
+struct HeadlessOptions {
+    bool enabled = false;
+    int frames = 300;
+    /** Directory to write frame captures to, nothing is captured if empty */
+    std::string capture_directory;
+    int capture_interval = 60;
+};
+
+// declared before the systems so that it is destroyed after them, they still release GL objects
+HeadlessContext headless_context;
+
 float remainder_time = 0;
 std::chrono::time_point<std::chrono::steady_clock> last_time;
 
@@ -37,12 +61,37 @@ AnimationSystem animation;
 ParticleSystem particles;
 PersistenceSystem persistence;
 
+/**
+ * Advance all systems by the given time and draw a frame.
+ * @return whether a frame was drawn
+ */
+bool step_systems(float elapsed_ms) {
+    float elapsed_remainder_ms = elapsed_ms + remainder_time;
+    world.step(elapsed_ms);
+    for (int i = 0; i < (int)floor(elapsed_remainder_ms / FIXED_UPDATE_MS); ++i) {
+        physics.step(FIXED_UPDATE_MS);
+        physics.detect_collisions();
+        world.handle_collisions(physics.collision_events());
+    }
+    ai.step(elapsed_ms);
+    animation.step(elapsed_ms);
+    remainder_time = fmod(elapsed_remainder_ms, (float)FIXED_UPDATE_MS);
+    particles.step(elapsed_ms);
+    // picks up changes made in the settings menu
+    renderer.setBloomQuality(static_cast<BloomQuality>(persistence.get_settings_bloom_quality()));
+    if (!renderer.draw()) {
+        return false;
+    }
+    world.on_frame_drawn();
+    return true;
+}
+
 /**
  * Advance the game loop one step
  */
 void step_game_loop() {
     if (world.is_over()) {
-        persistence.try_write_save();
+        persistence.flush();
 #ifdef __EMSCRIPTEN__
         emscripten_cancel_main_loop();
 #else
@@ -60,26 +109,87 @@ void step_game_loop() {
     last_time = now;
 
     if (window_focused) {
-        float elapsed_remainder_ms = elapsed_ms + remainder_time;
-        world.step(elapsed_ms);
-        for (int i = 0; i < (int)floor(elapsed_remainder_ms / FIXED_UPDATE_MS); ++i) {
-            physics.step(FIXED_UPDATE_MS);
-            physics.detect_collisions();
-            world.handle_collisions();
+        if (!step_systems(elapsed_ms)) {
+#ifndef __EMSCRIPTEN__
+            // there was no buffer swap to wait for vsync on, sleep until the next frame or input instead
+            glfwWaitEventsTimeout(IDLE_FRAME_S);
+#endif
+        }
+    }
+}
+
+/**
+ * Run the game for a fixed number of frames without a window or display, rendering offscreen. Logs how long every
+ * render stage took, and optionally writes some of the frames to PNG files.
+ */
+int run_headless(const HeadlessOptions& options) {
+    if (!headless_context.create()) {
+        return EXIT_FAILURE;
+    }
+
+    // there is no audio device to play to either
+    SDL_setenv("SDL_AUDIODRIVER", "dummy", 1);
+    SoundSystem::init();
+
+    renderer.init(nullptr);
+    persistence.init();
+    world.init(&persistence);
+    particles.init();
+
+    if (!options.capture_directory.empty()) {
+        std::filesystem::create_directories(options.capture_directory);
+    }
+
+    renderer.finishLoading();
+    renderer.enableProfiling();
+    const auto start = Clock::now();
+    for (int frame = 1; frame <= options.frames; frame++) {
+        step_systems(HEADLESS_FRAME_MS);
+        if (!options.capture_directory.empty() && frame % options.capture_interval == 0) {
+            const std::string file_name = "frame_" + std::to_string(frame) + ".png";
+            renderer.captureFrame(std::filesystem::path(options.capture_directory) / file_name);
         }
-        ai.step(elapsed_ms);
-        animation.step(elapsed_ms);
-        remainder_time = fmod(elapsed_remainder_ms, (float)FIXED_UPDATE_MS);
-        particles.step(elapsed_ms);
-        renderer.draw(elapsed_ms);
     }
+    const float total_ms =
+        static_cast<float>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count()) / 1000;
+
+    LOG_INFO("Rendered {} headless frames in {:.1f} ms ({:.2f} ms per frame)", options.frames, total_ms,
+             total_ms / static_cast<float>(std::max(options.frames, 1)));
+    renderer.logProfile();
+    persistence.flush();
+    return EXIT_SUCCESS;
 }
 
-int main() {
+HeadlessOptions parse_headless_options(int argc, char* argv[]) {
+    HeadlessOptions options;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--headless") {
+            options.enabled = true;
+        } else if (arg == "--frames" && has_value) {
+            options.frames = std::max(std::atoi(argv[++i]), 0);
+        } else if (arg == "--capture" && has_value) {
+            options.capture_directory = argv[++i];
+        } else if (arg == "--capture-every" && has_value) {
+            options.capture_interval = std::max(std::atoi(argv[++i]), 1);
+        } else {
+            LOG_WARN("Ignoring unknown argument '{}'", arg);
+        }
+    }
+    return options;
+}
+
+int main(int argc, char* argv[]) {
     // Initialize default logger
     raycast::logging::LogManager log_manager;
     log_manager.Initialize();
 
+    const HeadlessOptions headless_options = parse_headless_options(argc, argv);
+    if (headless_options.enabled) {
+        return run_headless(headless_options);
+    }
+
     // Initializing window
     window = world.create_window();
     if (!window) {
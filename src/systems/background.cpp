@@ -1,10 +1,9 @@
 #include "background.hpp"
 #include "ecs.hpp"
-#include "json.hpp"
 #include "registry.hpp"
+#include "scene_binary.hpp"
 #include "world_init.hpp"
 #include <filesystem>
-#include <fstream>
 
 namespace fs = std::filesystem;
 
@@ -18,57 +17,70 @@ void BackgroundSystem::init() {
     }
 }
 
-// Attempts to parse a specified scene. Returns true if successful. False if
-// not.
-bool BackgroundSystem::try_parse_background(std::string& background_tag) {
-    background_entities.clear();
+bool BackgroundSystem::load_background(const std::string& background_tag, BackgroundIR& parsed) const {
+    auto file = backgrounds.find(background_tag);
+    if (file == backgrounds.end()) {
+        LOG_ERROR("Unknown background {}", background_tag);
+        return false;
+    }
+    const std::string& filename = file->second;
 
-    if (background_tag.empty()) return true; // No background, deemed a success
-    std::string filename = backgrounds.at(background_tag);
-    std::ifstream background_file(filename);
+    // prefer the compiled background, the JSON is only parsed if it is missing or out of date
+    if (!scene_binary::read_background(scene_binary::compiled_background_path(background_tag),
+                                       scene_binary::source_hash(filename), parsed)) {
+        parsed = {};
+        if (!parse_background_file(filename, parsed)) {
+            return false;
+        }
+    }
+    std::error_code error;
+    parsed.write_time = fs::last_write_time(filename, error);
+    return true;
+}
 
-    if (background_file.is_open()) {
-        nlohmann::json j;
-        background_file >> j;
+void BackgroundSystem::add_prefetched(const std::string& background_tag, BackgroundIR&& parsed) {
+    background_cache.insert_or_assign(background_tag, std::move(parsed));
+}
 
-        background_file.close();
+// Attempts to load a specified background. Returns true if successful. False if
+// not. Background files are only parsed the first time they are loaded, or after they changed.
+bool BackgroundSystem::try_parse_background(std::string& background_tag) {
+    if (kept && background_tag == current_tag) {
+        kept = false;
+        LOG_INFO("Kept background {} from the previous scene", background_tag);
+        return true;
+    }
+    kept = false;
+    background_entities.clear();
+    current_tag.clear();
 
-        // Iterate through every entity specified, and add the component
-        // specified
-        try {
-            std::string main_background;
-            j["background"].get_to(main_background);
-            Entity background = Entity();
-            createSprite(background, vec2(native_width/2, native_height/2), vec2(native_width, native_height), 0, main_background, BACKGROUND);
-            background_entities.push_back(background);
-            for (auto& data : j["extra"]) {
-                vec2 position;
-                vec2 scale;
-                std::string texture;
-                data["position"][0].get_to(position.x);
-                data["position"][1].get_to(position.y);
-                data["scale"][0].get_to(scale.x);
-                data["scale"][1].get_to(scale.y);
-                data["texture"].get_to(texture);
-                Entity sprite = Entity();
-                createSprite(sprite, position, scale, 0, texture, FOREGROUND);
-                background_entities.push_back(sprite);
-            }
-            // catches all errors deriving from the standard exception class, this is better than a catch(...) statement since it gives
-            // us information about the error via e.what()
-        } catch (const std::exception& e) {
-            LOG_ERROR("Parsing file {} failed with error: {}\n", filename, e.what());
-            return false;
+    if (background_tag.empty()) return true; // No background, deemed a success
+    const std::string& filename = backgrounds.at(background_tag);
 
-            // catches any other error -- practically this case should never be reached since its good practice to have all errors extend the std::exception class
-        } catch (...) {
-            LOG_ERROR("Parsing file {} failed with an unknown error, check formatting\n", filename);
+    auto cached = background_cache.find(background_tag);
+    std::error_code error;
+    if (cached != background_cache.end() && fs::last_write_time(filename, error) != cached->second.write_time) {
+        background_cache.erase(cached);
+        cached = background_cache.end();
+    }
+    if (cached == background_cache.end()) {
+        BackgroundIR parsed;
+        if (!load_background(background_tag, parsed)) {
             return false;
         }
+        cached = background_cache.emplace(background_tag, std::move(parsed)).first;
     }
-    else {
-        LOG_ERROR("Failed to open file: {}\n", filename);
+
+    const BackgroundIR& parsed = cached->second;
+    Entity background = Entity();
+    createSprite(background, vec2(native_width/2, native_height/2), vec2(native_width, native_height), 0, parsed.main_background, BACKGROUND);
+    background_entities.push_back(background);
+    for (const Sprite& extra : parsed.extras) {
+        Entity sprite = Entity();
+        createSprite(sprite, extra.position, extra.scale, 0, extra.texture, FOREGROUND);
+        background_entities.push_back(sprite);
     }
+    current_tag = background_tag;
 
     LOG_INFO("Successfully loaded backgrounds\n");
     return true;
@@ -79,4 +91,24 @@ void BackgroundSystem::clear_background() {
         registry.remove_all_components_of(it);
     }
     background_entities.clear();
+    current_tag.clear();
+    kept = false;
+}
+
+void BackgroundSystem::keep_if_unchanged(const std::string& background_tag, std::vector<Entity>& kept_entities) {
+    kept = false;
+    if (background_tag.empty() || background_tag != current_tag || background_entities.empty()) {
+        return;
+    }
+
+    // an edited background file is loaded again, like it would be without the previous scene
+    auto cached = background_cache.find(background_tag);
+    std::error_code error;
+    if (cached == background_cache.end() ||
+        fs::last_write_time(backgrounds.at(background_tag), error) != cached->second.write_time) {
+        return;
+    }
+
+    kept_entities.insert(kept_entities.end(), background_entities.begin(), background_entities.end());
+    kept = true;
 }
@@ -3,7 +3,9 @@
 // internal
 #include "common.hpp"
 #include "render.hpp"
+#include "scene_ir.hpp"
 #include <map>
+#include <unordered_map>
 
 class BackgroundSystem {
   public:
@@ -11,9 +13,30 @@ class BackgroundSystem {
     bool try_parse_background(std::string& background_tag);
     void clear_background();
 
+    // Called before switching to a scene with the given background, empty for none. If that background is already
+    // shown and its file didn't change, its entities are added to `kept_entities` and the next
+    // `try_parse_background` keeps them instead of creating them again.
+    void keep_if_unchanged(const std::string& background_tag, std::vector<Entity>& kept_entities);
+
+    // Load a background from its compiled file, or its JSON file if there is no up-to-date compiled file. Doesn't
+    // touch the registry or the cache, so it can be called from the scene prefetch thread.
+    bool load_background(const std::string& background_tag, BackgroundIR& parsed) const;
+
+    // Add a background loaded ahead of time with `load_background` to the cache
+    void add_prefetched(const std::string& background_tag, BackgroundIR&& parsed);
+
   private:
     std::vector<Entity> background_entities;
 
+    // The background `background_entities` were created from
+    std::string current_tag;
+
+    // Whether `background_entities` are carried over into the scene being loaded, see `keep_if_unchanged`
+    bool kept = false;
+
+    // Background files parsed so far, by tag
+    std::unordered_map<std::string, BackgroundIR> background_cache;
+
     std::map<std::string, std::string> backgrounds {
         // dynamically allocated
     };
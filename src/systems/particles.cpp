@@ -11,7 +11,7 @@ void ParticleSystem::init() {
 
     // particle test
     // ParticleSpawner spawner;
-    // spawner.texture = texture_manager.get("white_circle");
+    // spawner.texture = texture_manager.getVirtual("white_circle");
     // spawner.position = vec2(160, 50);
     // spawner.initial_speed = 300.0f;
     // spawner.damping = 2500.0f;
@@ -117,11 +117,42 @@ void ParticleSystem::step(float elapsed_ms) {
         particle.speed = particle.speed < 0.0f ? 0.0f : particle.speed;
         particle.position += particle.speed * particle.direction * delta_time;
     }
+
+    step_trails(delta_time);
+}
+
+void ParticleSystem::step_trails(float delta_time) {
+    // backwards, so removing a trail doesn't skip the one moved into its place
+    for (int i = static_cast<int>(registry.lightTrails.size()) - 1; i >= 0; i--) {
+        LightTrail& trail = registry.lightTrails.components[i];
+        const bool has_light = registry.lightRays.has(trail.light);
+
+        if (has_light) {
+            trail.cooldown -= delta_time;
+            if (trail.cooldown <= 0.0f) {
+                trail.cooldown = LightTrail::POINT_INTERVAL;
+                const Motion& motion = registry.motions.get(trail.light);
+                trail.positions[trail.next_point] = motion.position - (motion.scale / 2.0f);
+                trail.ages[trail.next_point] = 0.0f;
+                trail.next_point = (trail.next_point + 1) % LightTrail::POINT_COUNT;
+            }
+        }
+
+        bool has_points = false;
+        for (float& age : trail.ages) {
+            age = min(age + delta_time, LightTrail::LIFETIME);
+            has_points |= age < LightTrail::LIFETIME;
+        }
+
+        if (!has_light && !has_points) {
+            registry.lightTrails.remove(registry.lightTrails.entities[i]);
+        }
+    }
 }
 
 Entity ParticleSystem::createLightDissipation(const Motion& light_motion) {
     ParticleSpawner spawner;
-    spawner.texture = texture_manager.get("white_circle");
+    spawner.texture = texture_manager.getVirtual("white_circle");
     spawner.position = (light_motion.position + (light_motion.scale / 2.0f)) - 1.0f;
     spawner.time_to_live = 1.0f;
     spawner.initial_speed = 300.0f;
@@ -152,7 +183,7 @@ Entity ParticleSystem::createLightDissipation(const Motion& light_motion) {
 
 Entity ParticleSystem::createPortalParticles(const Portal& portal, const vec4& color) {
     ParticleSpawner spawner;
-    spawner.texture = texture_manager.get("white_circle");
+    spawner.texture = texture_manager.getVirtual("white_circle");
     spawner.position = portal.position + vec2(13, 42) / 2.0f;
     spawner.initial_speed = 300.0f;
     spawner.damping = 3000.0f;
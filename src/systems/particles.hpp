@@ -7,6 +7,12 @@ class ParticleSystem {
     std::default_random_engine rng;
     std::uniform_real_distribution<float> uniform_dist;
 
+    /**
+     * Leave new trail points behind the light rays and age the existing ones. Trails are removed once their light
+     * ray is gone and all their points faded out.
+     */
+    static void step_trails(float delta_time);
+
 public:
     void init();
     void step(float elapsed_ms);
@@ -1,26 +1,188 @@
 #include "persistence.hpp"
 
 #include "common.hpp"
+#include "compositor.hpp"
 #include "log.hpp"
+#include "utils/hash.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+int clamp_bloom_quality(const int quality) {
+    return std::clamp(quality, 0, static_cast<int>(std::size(BLOOM_QUALITY_NAMES)) - 1);
+}
+
+namespace {
+// Write the file under a temporary name, make sure it reached the disk, and
+// only then move it over the old one. A crash or power loss at any point
+// leaves either the old or the new file, never a partially written one.
+bool write_file_atomically(const std::string& path, const std::string& contents) {
+    const std::string temporary_path = path + ".tmp";
+    FILE* file = std::fopen(temporary_path.c_str(), "wb");
+    if (file == nullptr) {
+        LOG_ERROR("Could not open {} for writing", temporary_path);
+        return false;
+    }
+
+    bool written = std::fwrite(contents.data(), 1, contents.size(), file) == contents.size() && std::fflush(file) == 0;
+#ifdef _WIN32
+    written = written && _commit(_fileno(file)) == 0;
+#else
+    written = written && fsync(fileno(file)) == 0;
+#endif
+    written = std::fclose(file) == 0 && written;
+
+    std::error_code error;
+    if (written) {
+        std::filesystem::rename(temporary_path, path, error);
+    }
+    if (!written || error) {
+        LOG_ERROR("Could not write {}", path);
+        std::filesystem::remove(temporary_path, error);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Header of the save file. It is followed by `level_bytes` bytes of packed level states, `settings_size` bytes of
+ * `SavedSettings`, and the FNV-1a hash of everything before it.
+ */
+struct SaveHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t level_bytes;
+    uint32_t settings_size;
+};
+
+/**
+ * `GameSettings` as stored in the save file. New fields go at the end: older saves have a smaller `settings_size`,
+ * and the fields they don't have keep their defaults.
+ */
+struct SavedSettings {
+    float sfx_volume;
+    float music_volume;
+    int32_t bloom_quality;
+    uint8_t hard_mode;
+    uint8_t padding[3];
+};
+
+constexpr char SAVE_MAGIC[4] = {'R', 'S', 'A', 'V'};
+
+// bump this when the layout above changes in a way older saves can't be read with
+constexpr uint32_t SAVE_VERSION = 1;
+
+const char* const LEVEL_STATE_NAMES[] = {"locked", "accessible", "beaten", "invalid"};
+
+uint8_t packed_state(const std::vector<uint8_t>& level_states, const int level) {
+    if (level < 0 || static_cast<size_t>(level) / 4 >= level_states.size()) {
+        return 0;
+    }
+    return (level_states[level / 4] >> (level % 4 * 2)) & 0b11;
+}
+
+template <typename T> void append(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+} // namespace
+
 void PersistenceSystem::init() {
+    if (!read_save() && read_legacy_save()) {
+        // saved in the new format by the next save
+        LOG_INFO("Migrating the JSON save data to the binary save format");
+        dirty = true;
+    }
+
+    if (get_state(1) != LEVEL_STATE::BEATEN) {
+        set_state(1, LEVEL_STATE::ACCESSIBLE);
+    }
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+    writer = std::thread(&PersistenceSystem::write_loop, this);
+#endif
+}
+
+PersistenceSystem::~PersistenceSystem() {
+    if (!writer.joinable()) {
+        return;
+    }
+    // anything still pending is written before the thread stops
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex);
+        stopping = true;
+    }
+    writer_wake.notify_one();
+    writer.join();
+}
+
+bool PersistenceSystem::read_save() {
+    std::ifstream save_file(player_data_path("save.dat"), std::ios::binary);
+    if (!save_file.is_open()) {
+        return false;
+    }
+    const std::string contents((std::istreambuf_iterator<char>(save_file)), std::istreambuf_iterator<char>());
+
+    SaveHeader header{};
+    if (contents.size() < sizeof(header)) {
+        LOG_ERROR("Save file is too short, ignoring it");
+        return false;
+    }
+    std::memcpy(&header, contents.data(), sizeof(header));
+    const size_t checksummed_size = sizeof(header) + header.level_bytes + header.settings_size;
+    if (std::memcmp(header.magic, SAVE_MAGIC, sizeof(SAVE_MAGIC)) != 0 || header.version != SAVE_VERSION ||
+        contents.size() != checksummed_size + sizeof(uint64_t)) {
+        LOG_ERROR("Save file is from an incompatible version of the game, ignoring it");
+        return false;
+    }
+    uint64_t checksum = 0;
+    std::memcpy(&checksum, contents.data() + checksummed_size, sizeof(checksum));
+    if (checksum != raycast::hash::fnv1a(contents.data(), checksummed_size)) {
+        LOG_ERROR("Save file is corrupted, ignoring it");
+        return false;
+    }
+
+    const char* levels = contents.data() + sizeof(header);
+    level_states.assign(levels, levels + header.level_bytes);
+
+    // settings added after the save was written keep their defaults
+    SavedSettings settings{current_settings.sfxVolume, current_settings.musicVolume, current_settings.bloomQuality,
+                           current_settings.hardMode, {}};
+    std::memcpy(&settings, levels + header.level_bytes, std::min<size_t>(header.settings_size, sizeof(settings)));
+    current_settings.sfxVolume = settings.sfx_volume;
+    current_settings.musicVolume = settings.music_volume;
+    current_settings.bloomQuality = clamp_bloom_quality(settings.bloom_quality);
+    current_settings.hardMode = settings.hard_mode != 0;
+
+    LOG_INFO("Loaded save ({} bytes)", contents.size());
+    return true;
+}
 
+bool PersistenceSystem::read_legacy_save() {
+    bool found = false;
     std::ifstream save_file(player_data_path("save"));
 
     if (save_file.is_open()) {
         nlohmann::json j;
         save_file >> j;
+        std::map<int, LEVEL_STATE> data;
         j.get_to(data);
+        for (const auto& [level, state] : data) {
+            set_state(level, state);
+        }
 
         LOG_INFO("Loading data: {}", j.dump());
 
         save_file.close();
-    }
-
-    if (data[1] != LEVEL_STATE::BEATEN) {
-        data[1] = LEVEL_STATE::ACCESSIBLE;
+        found = true;
     }
 
     std::ifstream setting_file(player_data_path("settings"));
@@ -33,66 +195,128 @@ void PersistenceSystem::init() {
         LOG_INFO("Loading settings: {}", j.dump());
 
         setting_file.close();
+        found = true;
     }
+    return found;
+}
 
+PersistenceSystem::LEVEL_STATE PersistenceSystem::get_state(int levelNum) const {
+    return static_cast<LEVEL_STATE>(packed_state(level_states, levelNum));
 }
 
-bool PersistenceSystem::get_is_accessible(int levelNum) {
-    LEVEL_STATE state = data[levelNum];
-    if (state != LEVEL_STATE::LOCKED) {
-        return true;
+void PersistenceSystem::set_state(int levelNum, LEVEL_STATE state) {
+    if (levelNum < 0) {
+        return;
     }
-    return false;
-}
-bool PersistenceSystem::get_is_beaten(int levelNum) {
-    LEVEL_STATE state = data[levelNum];
-    if (state == LEVEL_STATE::BEATEN) {
-        return true;
+    const size_t byte = static_cast<size_t>(levelNum) / 4;
+    if (byte >= level_states.size()) {
+        level_states.resize(byte + 1, 0);
     }
-    return false;
+    const int shift = levelNum % 4 * 2;
+    level_states[byte] = static_cast<uint8_t>((level_states[byte] & ~(0b11 << shift)) | (state << shift));
 }
-bool PersistenceSystem::get_is_locked(int levelNum) {
-    LEVEL_STATE state = data[levelNum];
-    if (state == LEVEL_STATE::LOCKED) {
-        return true;
-    }
-    return false;
+
+bool PersistenceSystem::get_is_accessible(int levelNum) const {
+    return get_state(levelNum) != LEVEL_STATE::LOCKED;
+}
+bool PersistenceSystem::get_is_beaten(int levelNum) const {
+    return get_state(levelNum) == LEVEL_STATE::BEATEN;
+}
+bool PersistenceSystem::get_is_locked(int levelNum) const {
+    return get_state(levelNum) == LEVEL_STATE::LOCKED;
 }
 void PersistenceSystem::set_beaten(int levelNum) {
-    data[levelNum] = LEVEL_STATE::BEATEN;
+    set_state(levelNum, LEVEL_STATE::BEATEN);
+    dirty = true;
 }
 void PersistenceSystem::set_accessible(int levelNum) {
-    if (data[levelNum] != LEVEL_STATE::BEATEN) { // Can only go locked -> accessible. Not beaten -> accessible
-        data[levelNum] = LEVEL_STATE::ACCESSIBLE;
+    if (get_state(levelNum) != LEVEL_STATE::BEATEN) { // Can only go locked -> accessible. Not beaten -> accessible
+        set_state(levelNum, LEVEL_STATE::ACCESSIBLE);
+        dirty = true;
     }
 }
 void PersistenceSystem::clear_data() {
-    for (auto &it : data) {
-        it.second = LEVEL_STATE::LOCKED;
-    }
-    data[1] = LEVEL_STATE::ACCESSIBLE;
+    std::fill(level_states.begin(), level_states.end(), 0);
+    set_state(1, LEVEL_STATE::ACCESSIBLE);
     LOG_INFO("Cleared data");
     try_write_save();
 }
 
 bool PersistenceSystem::try_write_save() {
-    json j = data;
+    dirty = false;
+    Snapshot snapshot{level_states, current_settings};
+    if (!writer.joinable()) {
+        write(snapshot);
+        return true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex);
+        pending = std::move(snapshot);
+    }
+    writer_wake.notify_one();
+    return true;
+}
 
-    std::ofstream save_file(player_data_path("save"));
-    save_file << j;
-    save_file.close();
+void PersistenceSystem::flush() {
+    if (dirty) {
+        try_write_save();
+    }
+    std::unique_lock<std::mutex> lock(writer_mutex);
+    writer_idle.wait(lock, [this] { return !pending && !writing; });
+}
 
-    LOG_INFO("Saving data: {}", j.dump());
+void PersistenceSystem::write_loop() {
+    std::unique_lock<std::mutex> lock(writer_mutex);
+    while (true) {
+        writer_wake.wait(lock, [this] { return pending || stopping; });
+        if (!pending) {
+            return;
+        }
 
-    j = current_settings;
+        // saves queued while this one is written replace each other in `pending`
+        Snapshot snapshot = std::move(*pending);
+        pending.reset();
+        writing = true;
+        lock.unlock();
+        write(snapshot);
+        lock.lock();
+        writing = false;
+        writer_idle.notify_all();
+    }
+}
 
-    std::ofstream setting_file(player_data_path("settings"));
-    setting_file << j;
-    setting_file.close();
+void PersistenceSystem::write(const Snapshot& snapshot) {
+    const GameSettings& settings = snapshot.settings;
+    const SavedSettings saved_settings{settings.sfxVolume, settings.musicVolume, settings.bloomQuality,
+                                       static_cast<uint8_t>(settings.hardMode), {}};
+    SaveHeader header{};
+    std::memcpy(header.magic, SAVE_MAGIC, sizeof(SAVE_MAGIC));
+    header.version = SAVE_VERSION;
+    header.level_bytes = static_cast<uint32_t>(snapshot.level_states.size());
+    header.settings_size = sizeof(SavedSettings);
 
-    LOG_INFO("Saving settings: {}", j.dump());
+    std::string contents;
+    append(contents, header);
+    contents.append(snapshot.level_states.begin(), snapshot.level_states.end());
+    append(contents, saved_settings);
+    append(contents, raycast::hash::fnv1a(contents.data(), contents.size()));
 
-    return true;
+    if (write_file_atomically(player_data_path("save.dat"), contents)) {
+        LOG_INFO("Saved {} bytes", contents.size());
+    }
+
+#ifdef ALLOW_DEBUG_FUNCTIONS
+    // a readable copy of the save, it is never read back
+    json j;
+    for (int level = 0; static_cast<size_t>(level) < snapshot.level_states.size() * 4; level++) {
+        if (const uint8_t state = packed_state(snapshot.level_states, level); state != LEVEL_STATE::LOCKED) {
+            j["levels"][std::to_string(level)] = LEVEL_STATE_NAMES[state];
+        }
+    }
+    j["settings"] = settings;
+    write_file_atomically(player_data_path("save.json"), j.dump(4));
+#endif
 }
 
 #ifdef ALLOW_DEBUG_FUNCTIONS
@@ -119,14 +343,26 @@ bool PersistenceSystem::get_settings_hard_mode() {
     return current_settings.hardMode;
 }
 
+int PersistenceSystem::get_settings_bloom_quality() {
+    return current_settings.bloomQuality;
+}
+
 void PersistenceSystem::set_settings_music_volume(float volume) {
     current_settings.musicVolume = volume;
+    dirty = true;
 }
 
 void PersistenceSystem::set_settings_sfx_volume(float volume) {
     current_settings.sfxVolume = volume;
+    dirty = true;
 }
 
 void PersistenceSystem::set_settings_hard_mode(bool hard) {
     current_settings.hardMode = hard;
+    dirty = true;
+}
+
+void PersistenceSystem::set_settings_bloom_quality(int quality) {
+    current_settings.bloomQuality = clamp_bloom_quality(quality);
+    dirty = true;
 }
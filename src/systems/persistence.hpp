@@ -1,7 +1,13 @@
 #pragma once
 
 #include "json.hpp"
+#include <condition_variable>
+#include <cstdint>
 #include <map>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
 #include "utils/defines.hpp"
 
 using json = nlohmann::json;
@@ -10,16 +16,23 @@ struct GameSettings {
     float sfxVolume = 0.7;
     float musicVolume = 0.7;
     bool hardMode = false;
+    // see BloomQuality, defaults to the highest quality
+    int bloomQuality = 3;
 };
 
+// Clamp a bloom quality read from disk to the valid BloomQuality levels
+int clamp_bloom_quality(int quality);
+
 inline void to_json(json& j, const GameSettings& c) {
-    j = json{{"sfxVolume", c.sfxVolume}, {"musicVolume", c.musicVolume}, {"hardMode", c.hardMode}};
+    j = json{{"sfxVolume", c.sfxVolume}, {"musicVolume", c.musicVolume}, {"hardMode", c.hardMode},
+             {"bloomQuality", c.bloomQuality}};
 }
 
 inline void from_json(const json& j, GameSettings& c) {
     if (j.contains("sfxVolume")) j.at("sfxVolume").get_to(c.sfxVolume);
     if (j.contains("musicVolume")) j.at("musicVolume").get_to(c.musicVolume);
     if (j.contains("hardMode")) j.at("hardMode").get_to(c.hardMode);
+    if (j.contains("bloomQuality")) c.bloomQuality = clamp_bloom_quality(j.at("bloomQuality").get<int>());
 }
 
 class PersistenceSystem {
@@ -30,20 +43,32 @@ class PersistenceSystem {
     };
 
   public:
+    ~PersistenceSystem();
     void init();
+
+    // Queue writing the save data and settings to disk on the save thread, the
+    // caller never waits for the disk. Saves queued while an earlier one is
+    // still pending are combined into a single write of the latest state.
     bool try_write_save();
+
+    // Queue a save if anything changed since the last one, and wait until
+    // everything queued is on disk. Call before exiting.
+    void flush();
+
     void clear_data();
-    bool get_is_accessible(int levelNum);
-    bool get_is_beaten(int levelNum);
-    bool get_is_locked(int levelNum);
+    bool get_is_accessible(int levelNum) const;
+    bool get_is_beaten(int levelNum) const;
+    bool get_is_locked(int levelNum) const;
     void set_beaten(int levelNum);
     void set_accessible(int levelNum);
     float get_settings_music_volume();
     float get_settings_sfx_volume();
     bool get_settings_hard_mode();
+    int get_settings_bloom_quality();
     void set_settings_music_volume(float volume);
     void set_settings_sfx_volume(float volume);
     void set_settings_hard_mode(bool hard);
+    void set_settings_bloom_quality(int quality);
 
 #ifdef ALLOW_DEBUG_FUNCTIONS
     void debug_set_all_accessible(int levelCount);
@@ -51,6 +76,44 @@ class PersistenceSystem {
 
 
   private:
-    std::map<int, LEVEL_STATE> data;
+    // The state of every level, indexed by level id and packed into 2 bits
+    // each, 4 levels per byte. Levels past the end are locked.
+    std::vector<uint8_t> level_states;
     GameSettings current_settings;
+
+    LEVEL_STATE get_state(int levelNum) const;
+    void set_state(int levelNum, LEVEL_STATE state);
+
+    // Read the binary save, see `write`. Returns false if it is missing,
+    // corrupted or from a newer version of the game.
+    bool read_save();
+
+    // Read the JSON save data and settings older versions of the game wrote
+    bool read_legacy_save();
+
+    // Whether anything changed since the last `try_write_save`
+    bool dirty = false;
+
+    // A copy of everything that is saved, handed to the save thread
+    struct Snapshot {
+        std::vector<uint8_t> level_states;
+        GameSettings settings;
+    };
+
+    // The save thread, only started on platforms with threads. Without it
+    // saves are written right away.
+    std::thread writer;
+    std::mutex writer_mutex;
+    std::condition_variable writer_wake;
+    std::condition_variable writer_idle;
+    std::optional<Snapshot> pending;
+    bool writing = false;
+    bool stopping = false;
+
+    void write_loop();
+
+    // Write the binary save: a header with a version, the packed level
+    // states, the settings and a checksum of all of it. With debug functions
+    // enabled, a readable JSON export is written next to it.
+    static void write(const Snapshot& snapshot);
 };
\ No newline at end of file
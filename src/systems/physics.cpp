@@ -225,8 +225,31 @@ bool PhysicsSystem::should_light_orbit(Entity light, Entity blackhole) {
     return (left_angle <= PhysicsSystem::MaxOrbitAngle || right_angle <= PhysicsSystem::MaxOrbitAngle);
 }
 
+void PhysicsSystem::add_collision_event(Entity entity, Entity other, int side, float overlap) {
+    COLLISION_PAIR pair;
+    if (registry.portals.has(entity) && registry.lightRays.has(other)) {
+        pair = COLLISION_PAIR::PORTAL_LIGHT;
+    } else if (registry.turtles.has(entity) && !registry.lightRays.has(other)) {
+        pair = COLLISION_PAIR::TURTLE_BARRIER;
+    } else if (!registry.lightRays.has(other) || registry.lightRays.has(entity)) {
+        // for now, only collisions involving light ray as other object are handled
+        return;
+    } else if (registry.reflectives.has(entity)) {
+        pair = COLLISION_PAIR::LIGHT_REFLECTION;
+    } else if (registry.minisuns.has(entity)) {
+        pair = COLLISION_PAIR::MINISUN_LIGHT;
+    } else if (registry.endCutsceneCounts.has(entity)) {
+        pair = COLLISION_PAIR::END_CUTSCENE_LIGHT;
+    } else {
+        pair = COLLISION_PAIR::LIGHT_ABSORBED;
+    }
+    events.push_back({entity, other, side, overlap, pair});
+}
+
 // check for collisions between entities that collide
 void PhysicsSystem::detect_collisions() {
+    events.clear();
+
     ComponentContainer<Collideable>& collideable_registry = registry.collideables;
     for (uint i = 0; i < collideable_registry.components.size(); i++) {
         Entity entity_i = collideable_registry.entities[i];
@@ -243,21 +266,8 @@ void PhysicsSystem::detect_collisions() {
             // (to ensure both orders exist for later collision handling)
             vec2 collision = Collisions::overlap(entity_i, entity_j);
             if (collision.x != 0) {
-                // LOG_INFO("Collision detected\n");
-                try {
-                    Collision& c1 = registry.collisions.emplace_with_duplicates(entity_i, entity_j);
-                    Collision& c2 = registry.collisions.emplace_with_duplicates(entity_j, entity_i);
-
-                    c1.side = collision.x;
-                    c2.side = collision.x;
-                    c1.overlap = collision.y;
-                    c2.overlap = collision.y;
-                } catch (...) {
-                    LOG_CRITICAL("Something BAD happened with Collisions");
-                }
-
-
-
+                add_collision_event(entity_i, entity_j, (int)collision.x, collision.y);
+                add_collision_event(entity_j, entity_i, (int)collision.x, collision.y);
             }
         }
     }
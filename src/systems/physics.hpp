@@ -5,6 +5,31 @@
 #include "ecs/ecs.hpp"
 #include "ecs/registry.hpp"
 
+#include <type_traits>
+#include <vector>
+
+// How a collision is handled, worked out once when it is detected
+enum class COLLISION_PAIR {
+    PORTAL_LIGHT,       // a light ray entering a portal
+    TURTLE_BARRIER,     // the turtle running into anything but light
+    LIGHT_REFLECTION,   // a light ray hitting a reflective surface
+    MINISUN_LIGHT,      // a light ray lighting up a minisun, then absorbed
+    END_CUTSCENE_LIGHT, // a light ray advancing the end cutscene, then absorbed
+    LIGHT_ABSORBED,     // a light ray hitting anything else
+};
+
+// A collision between two entities, handled for `entity`. Collisions are
+// detected once per pair, but produce an event for each order of the pair
+// that has something to handle.
+struct CollisionEvent {
+    Entity entity;
+    Entity other;
+    int side = 0;        // side (1 for y, 2 for x) the collision occurrs on
+    float overlap = 0.f; // amount the two objects overlap
+    COLLISION_PAIR pair = COLLISION_PAIR::LIGHT_ABSORBED;
+};
+static_assert(std::is_trivially_copyable_v<CollisionEvent>);
+
 // A simple physics system that moves rigid bodies and checks for collision
 class PhysicsSystem {
   public:
@@ -28,7 +53,16 @@ class PhysicsSystem {
     void detect_collisions();
     bool should_light_orbit(Entity light, Entity blackhole);
     PhysicsSystem() = default;
+
+    // The collisions found by the last `detect_collisions`
+    const std::vector<CollisionEvent>& collision_events() const { return events; }
+
   private:
+    // Reused every step, it is cleared but never shrunk
+    std::vector<CollisionEvent> events;
+
+    // Record the event of `entity` colliding with `other`, if it has anything to handle
+    void add_collision_event(Entity entity, Entity other, int side, float overlap);
 
     static bool shouldStep();
 };
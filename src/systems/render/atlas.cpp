@@ -0,0 +1,82 @@
+#include "atlas.hpp"
+
+#include <climits>
+
+SkylinePacker::SkylinePacker(const int width, const int max_height) : width(width), max_height(max_height) {
+    skyline.push_back({0, 0, width});
+}
+
+bool SkylinePacker::fits(const size_t index, const ivec2 size, int& out_y) const {
+    const int x = skyline[index].x;
+    if (x + size.x > width) {
+        return false;
+    }
+
+    // the rectangle rests on the highest segment below it
+    int remaining = size.x;
+    int y = skyline[index].y;
+    for (size_t i = index; remaining > 0 && i < skyline.size(); i++) {
+        y = std::max(y, skyline[i].y);
+        if (y + size.y > max_height) {
+            return false;
+        }
+        remaining -= skyline[i].width;
+    }
+
+    out_y = y;
+    return true;
+}
+
+bool SkylinePacker::pack(const ivec2 size, ivec2& out_position) {
+    size_t best_index = skyline.size();
+    int best_bottom = INT_MAX;
+    int best_width = INT_MAX;
+
+    for (size_t i = 0; i < skyline.size(); i++) {
+        int y;
+        if (!fits(i, size, y)) {
+            continue;
+        }
+        // prefer the lowest spot, then the narrowest segment to waste as little space as possible
+        const int bottom = y + size.y;
+        if (bottom < best_bottom || (bottom == best_bottom && skyline[i].width < best_width)) {
+            best_index = i;
+            best_bottom = bottom;
+            best_width = skyline[i].width;
+        }
+    }
+
+    if (best_index == skyline.size()) {
+        return false;
+    }
+
+    const Segment placed = {skyline[best_index].x, best_bottom, size.x};
+    skyline.insert(skyline.begin() + static_cast<std::ptrdiff_t>(best_index), placed);
+
+    // shrink or remove the segments that are now covered by the new one
+    const int placed_right = placed.x + placed.width;
+    size_t i = best_index + 1;
+    while (i < skyline.size() && skyline[i].x < placed_right) {
+        const int shrink = placed_right - skyline[i].x;
+        skyline[i].x += shrink;
+        skyline[i].width -= shrink;
+        if (skyline[i].width > 0) {
+            break;
+        }
+        skyline.erase(skyline.begin() + static_cast<std::ptrdiff_t>(i));
+    }
+
+    // merge neighbouring segments of the same height
+    for (size_t j = 0; j + 1 < skyline.size();) {
+        if (skyline[j].y == skyline[j + 1].y) {
+            skyline[j].width += skyline[j + 1].width;
+            skyline.erase(skyline.begin() + static_cast<std::ptrdiff_t>(j + 1));
+        } else {
+            j++;
+        }
+    }
+
+    used_height = std::max(used_height, best_bottom);
+    out_position = {placed.x, best_bottom - size.y};
+    return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "common.hpp"
+
+/**
+ * Packs rectangles into an area of fixed width using the skyline bottom-left heuristic.
+ *
+ * The packer keeps track of the "skyline", the top edge of everything packed so far, as a list of horizontal
+ * segments. A new rectangle is placed on top of the skyline wherever its top edge ends up lowest, which keeps the
+ * packed area dense as long as rectangles are packed from tallest to shortest.
+ */
+class SkylinePacker {
+    struct Segment {
+        int x;
+        int y;
+        int width;
+    };
+
+    std::vector<Segment> skyline;
+    int width;
+    int max_height;
+    int used_height = 0;
+
+    /**
+     * Check whether a rectangle of the given size can be placed with its left edge at the given skyline segment.
+     * @param out_y The lowest y-coordinate the rectangle can be placed at
+     */
+    bool fits(size_t index, ivec2 size, int& out_y) const;
+
+  public:
+    SkylinePacker(int width, int max_height);
+
+    /**
+     * Find a spot for a rectangle of the given size and reserve it.
+     *
+     * @param out_position The top left corner of the reserved spot
+     * @return false if the rectangle doesn't fit anymore
+     */
+    bool pack(ivec2 size, ivec2& out_position);
+
+    [[nodiscard]] ivec2 size() const { return {width, used_height}; }
+};
@@ -0,0 +1,50 @@
+#include "gpu_timer.hpp"
+
+namespace {
+// weight of the newest measurement in the smoothed time
+constexpr float SMOOTHING = 0.1f;
+} // namespace
+
+GpuTimer::~GpuTimer() {
+#ifndef __EMSCRIPTEN__
+    if (queries[0] != 0) {
+        glDeleteQueries(QUERY_COUNT, queries.data());
+    }
+#endif
+}
+
+void GpuTimer::begin() {
+#ifndef __EMSCRIPTEN__
+    if (queries[0] == 0) {
+        glGenQueries(QUERY_COUNT, queries.data());
+    }
+
+    // collect the result of the query that is about to be reused, which was issued QUERY_COUNT frames ago
+    const GLuint query = queries[next_query];
+    if (pending[next_query]) {
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available == GL_TRUE) {
+            GLuint64 elapsed_ns = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed_ns);
+            const float elapsed_ms = static_cast<float>(elapsed_ns) / 1e6f;
+            // the very first result tends to include lazy driver work like shader compilation, so it is skipped
+            if (has_result) {
+                smoothed_ms = smoothed_ms == 0 ? elapsed_ms : smoothed_ms + (elapsed_ms - smoothed_ms) * SMOOTHING;
+            }
+            has_result = true;
+        }
+        // results that are not available yet are dropped rather than waited for
+    }
+
+    glBeginQuery(GL_TIME_ELAPSED, query);
+#endif
+}
+
+void GpuTimer::end() {
+#ifndef __EMSCRIPTEN__
+    glEndQuery(GL_TIME_ELAPSED);
+    pending[next_query] = true;
+    next_query = (next_query + 1) % QUERY_COUNT;
+#endif
+}
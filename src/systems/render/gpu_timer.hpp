@@ -0,0 +1,39 @@
+#pragma once
+#include "common.hpp"
+
+#include <array>
+
+/**
+ * Measures how long the GPU takes for the commands issued between `begin` and `end`.
+ *
+ * Results arrive a few frames late, so the timer cycles through several queries and never waits for the GPU. The
+ * reported time is smoothed over the last frames to make it readable. Timer queries don't exist in WebGL, so on the
+ * web build the timer does nothing and always reports 0.
+ */
+class GpuTimer {
+    static constexpr size_t QUERY_COUNT = 4;
+
+    std::array<GLuint, QUERY_COUNT> queries = {};
+    std::array<bool, QUERY_COUNT> pending = {};
+    size_t next_query = 0;
+    bool has_result = false;
+    float smoothed_ms = 0;
+
+  public:
+    GpuTimer() = default;
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+    ~GpuTimer();
+
+    /**
+     * Start timing. Only one timer can be running at a time.
+     */
+    void begin();
+
+    void end();
+
+    /**
+     * The GPU time of the timed commands in milliseconds, averaged over the last few frames.
+     */
+    [[nodiscard]] float milliseconds() const { return smoothed_ms; }
+};
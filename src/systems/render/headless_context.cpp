@@ -0,0 +1,81 @@
+#include "headless_context.hpp"
+#include "logging/log.hpp"
+
+#ifdef RAYCAST_HEADLESS
+
+// keep X11's macros out, there is no display to talk to anyway
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+bool HeadlessContext::create() {
+    const auto get_platform_display =
+        reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (get_platform_display == nullptr) {
+        LOG_ERROR("EGL does not support platform displays, can't render headless");
+        return false;
+    }
+
+    EGLDisplay egl_display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    EGLint major, minor;
+    if (egl_display == EGL_NO_DISPLAY || !eglInitialize(egl_display, &major, &minor)) {
+        LOG_ERROR("Failed to initialize a surfaceless EGL display");
+        return false;
+    }
+    display = egl_display;
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        LOG_ERROR("EGL does not support desktop OpenGL");
+        return false;
+    }
+
+    // there is nothing to draw to besides framebuffer objects, so any config will do, or none at all
+    const EGLint config_attributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    EGLConfig config = nullptr;
+    EGLint config_count = 0;
+    eglChooseConfig(egl_display, config_attributes, &config, 1, &config_count);
+
+    const EGLint context_attributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE,
+    };
+    EGLContext egl_context = eglCreateContext(egl_display, config_count > 0 ? config : EGL_NO_CONFIG_KHR,
+                                              EGL_NO_CONTEXT, context_attributes);
+    if (egl_context == EGL_NO_CONTEXT) {
+        LOG_ERROR("Failed to create an OpenGL 3.3 context (EGL error {:#x})", eglGetError());
+        return false;
+    }
+    context = egl_context;
+
+    if (!eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, egl_context)) {
+        LOG_ERROR("Failed to make the headless context current (EGL error {:#x})", eglGetError());
+        return false;
+    }
+
+    LOG_INFO("Created headless EGL {}.{} context", major, minor);
+    return true;
+}
+
+HeadlessContext::~HeadlessContext() {
+    if (display == nullptr) {
+        return;
+    }
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context != nullptr) {
+        eglDestroyContext(display, context);
+    }
+    eglTerminate(display);
+}
+
+#else
+
+bool HeadlessContext::create() {
+    LOG_ERROR("This build has no headless rendering support, it needs EGL");
+    return false;
+}
+
+HeadlessContext::~HeadlessContext() = default;
+
+#endif
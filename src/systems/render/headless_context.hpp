@@ -0,0 +1,24 @@
+#pragma once
+
+/**
+ * An OpenGL 3.3 core context without any window or display, for rendering offscreen (see `RenderSystem::init`).
+ *
+ * Uses EGL on Mesa's surfaceless platform, which works on machines without a GPU (through llvmpipe) and without a
+ * display server, e.g. in CI. Only available when the build found EGL, `create` fails otherwise.
+ */
+class HeadlessContext {
+    void* display = nullptr;
+    void* context = nullptr;
+
+  public:
+    HeadlessContext() = default;
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+    ~HeadlessContext();
+
+    /**
+     * Create the context and make it current on the calling thread.
+     * @return whether a context could be created
+     */
+    bool create();
+};
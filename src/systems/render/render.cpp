@@ -4,17 +4,48 @@
 #include <SDL.h>
 
 #include "ecs/registry.hpp"
+#include "utils/hash.hpp"
+#include "utils/png.hpp"
+#include "utils/time.hpp"
 
 #include <iostream>
+#include <thread>
 
 TextureManager texture_manager;
 ShaderManager shader_manager;
+StreamingBuffer streaming_buffer;
+
+namespace {
+using raycast::hash::fnv1aValue;
+
+/** Bytes each frame can stream before the streaming buffer has to grow, enough for a few thousand particles */
+constexpr size_t STREAMING_BUFFER_FRAME_SIZE = 256 * 1024;
+
+/** Set by GLFW callbacks when the window contents have to be drawn again */
+bool window_damaged = false;
+
+/**
+ * Hash every component in a container together with its entity. The combined hash doesn't depend on the order the
+ * components are stored in, since the sprite stage sorts materials every frame.
+ */
+template <typename Component, typename HashComponent>
+uint64_t hashContainer(ComponentContainer<Component>& container, const uint64_t hash, HashComponent hash_component) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < container.components.size(); i++) {
+        const uint64_t entity_hash = fnv1aValue(static_cast<unsigned int>(container.entities[i]));
+        sum += hash_component(container.components[i], entity_hash);
+    }
+    return fnv1aValue(sum, fnv1aValue(container.components.size(), hash));
+}
+} // namespace
 
 void RenderSystem::init(GLFWwindow* window_arg) {
     this->window = window_arg;
 
-    glfwMakeContextCurrent(window);
-    glfwSwapInterval(1); // vsync
+    if (window != nullptr) {
+        glfwMakeContextCurrent(window);
+        glfwSwapInterval(1); // vsync
+    }
 
 #ifndef __EMSCRIPTEN__
     // Load OpenGL function pointers
@@ -27,6 +58,11 @@ void RenderSystem::init(GLFWwindow* window_arg) {
 
     texture_manager.init();
     shader_manager.init();
+    streaming_buffer.init(STREAMING_BUFFER_FRAME_SIZE);
+
+    file_watcher.watch(textures_path("albedo"));
+    file_watcher.watch(textures_path("normal"));
+    file_watcher.watch(shader_path(""));
 
     world_stage.init();
     mesh_stage.init();
@@ -34,6 +70,12 @@ void RenderSystem::init(GLFWwindow* window_arg) {
     text_stage.init();
     composite_stage.init(window);
 
+    // the previous frame can't simply stay on screen if the window was resized or its contents got lost
+    if (window != nullptr) {
+        glfwSetFramebufferSizeCallback(window, [](GLFWwindow*, int, int) { window_damaged = true; });
+        glfwSetWindowRefreshCallback(window, [](GLFWwindow*) { window_damaged = true; });
+    }
+
     checkGlErrors();
 }
 
@@ -43,43 +85,181 @@ void RenderSystem::updateShaders() {
     particle_stage.updateShaders();
     text_stage.updateShaders();
     composite_stage.updateShaders();
+    world_stage.invalidateStatic();
 }
 
-void RenderSystem::updateTextures() {
+void RenderSystem::updateTextures(const std::set<std::string>& texture_names) {
+    if (texture_names.empty()) {
+        return;
+    }
+
+    // group the materials by texture first, most reloads only touch a handful of them
+    std::unordered_map<std::string, std::vector<Material*>> users;
     for (auto& material : registry.materials.components) {
-        material.texture.albedo = texture_manager.get(material.texture.name);
-        material.texture.normal = texture_manager.getNormal(material.texture.name);
+        if (texture_names.count(material.texture.name) > 0) {
+            users[material.texture.name].push_back(&material);
+        }
+    }
+
+    for (const auto& [name, materials] : users) {
+        const TextureRegion& region = texture_manager.getRegion(name);
+        LOG_DEBUG("Resolving texture '{}' again for {} materials", name, materials.size());
+        for (Material* material : materials) {
+            material->texture.albedo = region.albedo;
+            material->texture.normal = region.normal;
+            material->texture.uv_rect = region.uv_rect;
+        }
     }
 }
 
+void RenderSystem::setBloomQuality(const BloomQuality quality) {
+    if (quality != composite_stage.getBloomQuality()) {
+        composite_stage.setBloomQuality(quality);
+        force_redraw = true;
+    }
+}
+
+void RenderSystem::finishLoading() {
+    while (texture_manager.loading()) {
+        texture_manager.pump();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+bool RenderSystem::captureFrame(const std::filesystem::path& path) const {
+    std::vector<uint8_t> pixels;
+    ivec2 size;
+    composite_stage.readPixels(pixels, size);
+    if (!raycast::png::write(path, size.x, size.y, pixels.data())) {
+        LOG_ERROR("Failed to write frame capture '{}'", path.string());
+        return false;
+    }
+    return true;
+}
+
+uint64_t RenderSystem::sceneFingerprint() {
+    uint64_t hash = raycast::hash::FNV_OFFSET_BASIS;
+
+    hash = hashContainer(registry.motions, hash, hashMotion);
+    hash = hashContainer(registry.materials, hash, hashMaterial);
+    hash = hashContainer(registry.texts, hash, [](const Text& text, uint64_t h) {
+        h = raycast::hash::fnv1a(text.text, h);
+        h = fnv1aValue(text.position, h);
+        h = fnv1aValue(text.size, h);
+        h = fnv1aValue(text.color, h);
+        h = fnv1aValue(text.layer, h);
+        return fnv1aValue(text.centered, h);
+    });
+    hash = hashContainer(registry.particles, hash, [](const Particle& particle, uint64_t h) {
+        h = fnv1aValue(particle.texture, h);
+        h = fnv1aValue(particle.position, h);
+        h = fnv1aValue(particle.color, h);
+        h = fnv1aValue(particle.scale, h);
+        return fnv1aValue(particle.angle, h);
+    });
+    hash = hashContainer(registry.lightTrails, hash, [](const LightTrail& trail, uint64_t h) {
+        h = fnv1aValue(trail.positions, h);
+        return fnv1aValue(trail.ages, h);
+    });
+    hash = hashContainer(registry.pointLights, hash, [](const PointLight& light, uint64_t h) {
+        h = fnv1aValue(light.diffuse, h);
+        h = fnv1aValue(light.linear, h);
+        h = fnv1aValue(light.quadratic, h);
+        return fnv1aValue(light.constant, h);
+    });
+    hash = hashContainer(registry.ambientLights, hash,
+                         [](const AmbientLight& light, const uint64_t h) { return fnv1aValue(light.color, h); });
+    hash = hashContainer(registry.minisuns, hash, [](const MiniSun& minisun, uint64_t h) {
+        h = fnv1aValue(minisun.lit, h);
+        return fnv1aValue(minisun.light_level_percentage, h);
+    });
+    hash = hashContainer(registry.highlightables, hash, [](const Highlightable& highlightable, const uint64_t h) {
+        return fnv1aValue(highlightable.isHighlighted, h);
+    });
+
+    // only which entities have these matters
+    hash = hashContainer(registry.meshes, hash, [](const Mesh&, const uint64_t h) { return h; });
+    hash = hashContainer(registry.litEntities, hash, [](const LightUp&, const uint64_t h) { return h; });
+    hash = hashContainer(registry.invisibles, hash, [](const Invisible&, const uint64_t h) { return h; });
+
+    return hash;
+}
+
 /**
  * Render our game world
  * http://www.opengl-tutorial.org/intermediate-tutorials/tutorial-14-render-to-texture/
  */
-void RenderSystem::draw(float elapsed_ms) {
-    hot_reload_time += elapsed_ms;
-    if (hot_reload_time > hot_reload_interval) {
-        hot_reload_time = 0.0;
-        if (texture_manager.update()) {
-            updateTextures();
-        }
-        if (shader_manager.update()) {
+bool RenderSystem::draw() {
+    // textures that finish loading replace their placeholders
+    force_redraw |= texture_manager.loading();
+    if (texture_manager.pump()) {
+        world_stage.invalidateStatic();
+    }
+
+    const std::vector<std::filesystem::path> changed_files = file_watcher.poll();
+    if (!changed_files.empty()) {
+        if (shader_manager.update(changed_files)) {
             updateShaders();
         }
+        force_redraw = true;
+        pending_texture_changes.insert(pending_texture_changes.end(), changed_files.begin(), changed_files.end());
+    }
+    // don't race the initial texture load, the changes are picked up once it is done
+    if (!pending_texture_changes.empty() && !texture_manager.loading()) {
+        // textures that keep their region are updated in place, so the static sprites have to be drawn again either way
+        updateTextures(texture_manager.update(pending_texture_changes));
+        pending_texture_changes.clear();
+        world_stage.invalidateStatic();
     }
 
     if (render_skips > 0) {
         render_skips--;
-        return;
+        return false;
     }
 
+    // menus and paused levels can go for a long time without anything changing on screen
+    const uint64_t fingerprint = sceneFingerprint();
+    // headless frames are captured or measured, so they are always drawn
+    if (window != nullptr && !force_redraw && !window_damaged && fingerprint == presented_fingerprint) {
+        skipped_frames++;
+        return false;
+    }
+    if (skipped_frames > 0) {
+        LOG_DEBUG("Scene changed after {} unchanged frames", skipped_frames);
+        skipped_frames = 0;
+    }
+    presented_fingerprint = fingerprint;
+    if (force_redraw) {
+        world_stage.invalidateStatic();
+    }
+    force_redraw = false;
+    window_damaged = false;
+
+    profiler.beginFrame();
+    streaming_buffer.beginFrame();
     world_stage.draw();
+    profiler.endStage(StageProfiler::SPRITES, world_stage.getCullStats());
     mesh_stage.draw();
+    profiler.endStage(StageProfiler::MESHES, mesh_stage.getCullStats());
     particle_stage.draw();
+    profiler.endStage(StageProfiler::PARTICLES, particle_stage.getCullStats());
     text_stage.draw();
+    profiler.endStage(StageProfiler::TEXT, text_stage.getCullStats());
     composite_stage.draw();
+    profiler.endStage(StageProfiler::COMPOSITE);
+    streaming_buffer.endFrame();
+    profiler.endFrame();
 
     // flicker-free display with a double buffer
-    glfwSwapBuffers(window);
+    if (window != nullptr) {
+        glfwSwapBuffers(window);
+    }
     checkGlErrors();
+
+    if (!presented_first_frame) {
+        presented_first_frame = true;
+        LOG_INFO("Presented first frame {:.1f} ms after startup{}", raycast::time::ms_since(raycast::time::process_start),
+                 texture_manager.loading() ? ", textures are still loading" : "");
+    }
+    return true;
 }
@@ -5,9 +5,12 @@
 #include "mesh.hpp"
 #include "particle.hpp"
 #include "shader.hpp"
+#include "stage_profiler.hpp"
 #include "stages/sprite.hpp"
 #include "stages/text.hpp"
+#include "streaming_buffer.hpp"
 #include "texture.hpp"
+#include "utils/file_watcher.hpp"
 
 /**
  * Global texture manager. There should only be one instance of this.
@@ -19,13 +22,19 @@ extern TextureManager texture_manager;
  */
 extern ShaderManager shader_manager;
 
+/**
+ * Global buffer that the render stages stream their per-frame vertex and instance data through.
+ */
+extern StreamingBuffer streaming_buffer;
+
 /**
  * Shorthand for getting a texture from the texture manager.
  * @param name Name of the texture
  * @return A texture handle for the texture with the given `name`
  */
 inline TextureMaterial get_tex(const std::string& name) {
-    return {name, texture_manager.get(name), texture_manager.getNormal(name)};
+    const TextureRegion& region = texture_manager.getRegion(name);
+    return {name, region.albedo, region.normal, 0, 0, {1, 1}, region.uv_rect};
 }
 
 /**
@@ -39,20 +48,75 @@ class RenderSystem {
     TextStage text_stage;
     CompositorStage composite_stage;
 
-    /** Window handle */
+    /** Window handle, null when rendering headless */
     GLFWwindow* window = nullptr;
 
-    float hot_reload_interval = 1000.0;
-    float hot_reload_time = 0.0;
+    StageProfiler profiler;
+
+    /** Watches the texture and shader folders for hot reloading */
+    FileWatcher file_watcher;
+
+    /** Texture files that changed while textures were still loading */
+    std::vector<std::filesystem::path> pending_texture_changes;
+
+    bool presented_first_frame = false;
+
+    /** Fingerprint of everything that was on screen in the last presented frame, see `sceneFingerprint` */
+    uint64_t presented_fingerprint = 0;
+
+    /** Set when something outside of the registry changed what ends up on screen, e.g. a texture finished loading */
+    bool force_redraw = true;
+
+    size_t skipped_frames = 0;
+
+    /**
+     * Hash all the component state the render stages read. Two frames with the same fingerprint look identical.
+     */
+    [[nodiscard]] static uint64_t sceneFingerprint();
 
     void updateShaders();
 
-    void updateTextures();
+    /**
+     * Look up the textures of the materials using one of the given textures again.
+     */
+    void updateTextures(const std::set<std::string>& texture_names);
 
   public:
-    /** Initialize the window. */
+    /**
+     * Initialize the window.
+     * @param window The window to render into. If null, the renderer runs headless: it uses whatever OpenGL context
+     * is current (see `HeadlessContext`), draws every frame into an offscreen framebuffer and never skips one.
+     */
     void init(GLFWwindow* window);
 
-    /** Draw all visible, renderable entities. */
-    void draw(float elapsed_ms);
+    /**
+     * Draw all visible, renderable entities. If nothing changed since the last frame, nothing is drawn and the
+     * previous frame stays on screen.
+     *
+     * @return whether a new frame was presented
+     */
+    bool draw();
+
+    void setBloomQuality(BloomQuality quality);
+
+    /**
+     * Block until all textures are loaded, so that the following frames look the same on every run.
+     */
+    void finishLoading();
+
+    /**
+     * Write the last drawn frame to a PNG file.
+     * @return whether the file could be written
+     */
+    bool captureFrame(const std::filesystem::path& path) const;
+
+    /**
+     * Measure the CPU and GPU time of every render stage from now on, see `StageProfiler`.
+     */
+    void enableProfiling() { profiler.setEnabled(true); }
+
+    /**
+     * Log the average time every render stage took since profiling was enabled.
+     */
+    void logProfile() { profiler.finish(); }
 };
@@ -1,14 +1,62 @@
 #include "shader.hpp"
 #include "common.hpp"
+#include "utils/hash.hpp"
+#include "utils/mapped_file.hpp"
+#include "utils/time.hpp"
 
+#include <algorithm>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <set>
 #include <sstream>
 
-bool compileShader(const GLuint shader) {
-    glCompileShader(shader);
-    checkGlErrors();
+namespace {
+/**
+ * Header of a program binary cache file. It is followed by `binary_size` bytes of driver specific program binary.
+ */
+struct CachedProgramHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t binary_format;
+    uint32_t binary_size;
+};
+
+constexpr char CACHED_PROGRAM_MAGIC[4] = {'R', 'P', 'R', 'G'};
+constexpr uint32_t CACHED_PROGRAM_VERSION = 1;
+
+bool hasExtension(const std::string& name) {
+    GLint extension_count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+    for (GLint i = 0; i < extension_count; i++) {
+        const auto* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if (extension != nullptr && name == extension) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string glString(const GLenum name) {
+    const auto* string = reinterpret_cast<const char*>(glGetString(name));
+    return string != nullptr ? string : "";
+}
+
+bool readFile(const std::string& path, std::string& out) {
+    std::ifstream is(path);
+    if (!is.good()) {
+        return false;
+    }
+    std::stringstream ss;
+    ss << is.rdbuf();
+    out = ss.str();
+    return true;
+}
+} // namespace
+
+bool checkCompileStatus(const GLuint shader) {
     GLint success = 0;
     glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
     if (success == GL_FALSE) {
@@ -16,7 +64,6 @@ bool compileShader(const GLuint shader) {
         glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &log_len);
         std::vector<char> log(log_len);
         glGetShaderInfoLog(shader, log_len, &log_len, log.data());
-        glDeleteShader(shader);
 
         checkGlErrors();
 
@@ -27,22 +74,116 @@ bool compileShader(const GLuint shader) {
     return true;
 }
 
-bool loadShader(const std::string& vs_path, const std::string& fs_path, GLuint& out_program) {
-    // Opening files
-    std::ifstream vs_is(vs_path);
-    std::ifstream fs_is(fs_path);
-    if (!vs_is.good() || !fs_is.good()) {
-        fprintf(stderr, "Failed to load shader files %s, %s", vs_path.c_str(), fs_path.c_str());
+bool checkLinkStatus(const GLuint program) {
+    GLint is_linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &is_linked);
+    if (is_linked == GL_FALSE) {
+        GLint log_len;
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &log_len);
+        std::vector<char> log(std::max(log_len, 1));
+        glGetProgramInfoLog(program, log_len, &log_len, log.data());
+        checkGlErrors();
+
+        fprintf(stderr, "Link error: %s", log.data());
+        return false;
+    }
+    return true;
+}
+
+std::string ShaderManager::cachedProgramPath(const std::string& name) {
+    return cache_path("shaders/" + name + ".rprg");
+}
+
+bool ShaderManager::loadCachedProgram(const std::string& name, const uint64_t key, GLuint& out_program) const {
+    if (!program_binaries_supported) {
+        return false;
+    }
+
+    MappedFile file;
+    if (!file.open(cachedProgramPath(name)) || file.size() < sizeof(CachedProgramHeader)) {
         return false;
     }
 
-    // Reading sources
-    std::stringstream vs_ss, fs_ss;
-    vs_ss << vs_is.rdbuf();
-    fs_ss << fs_is.rdbuf();
+    CachedProgramHeader header{};
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, CACHED_PROGRAM_MAGIC, sizeof(CACHED_PROGRAM_MAGIC)) != 0 ||
+        header.version != CACHED_PROGRAM_VERSION || header.key != key ||
+        file.size() != sizeof(header) + header.binary_size) {
+        return false;
+    }
 
-    std::string vs_str = vs_ss.str();
-    std::string fs_str = fs_ss.str();
+    const GLuint program = glCreateProgram();
+    glProgramBinary(program, header.binary_format, file.data() + sizeof(header), static_cast<GLsizei>(header.binary_size));
+
+    // drivers may reject binaries even for the same renderer and version, e.g. after a driver update
+    GLint is_linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &is_linked);
+    if (is_linked == GL_FALSE) {
+        glDeleteProgram(program);
+        // swallow the error glProgramBinary may have raised for an unsupported format
+        while (glGetError() != GL_NO_ERROR) {
+        }
+        return false;
+    }
+
+    out_program = program;
+    return true;
+}
+
+void ShaderManager::writeCachedProgram(const std::string& name, const uint64_t key, const GLuint program) const {
+    if (!program_binaries_supported) {
+        return;
+    }
+
+    GLint binary_size = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binary_size);
+    if (binary_size <= 0) {
+        return;
+    }
+
+    CachedProgramHeader header{};
+    std::memcpy(header.magic, CACHED_PROGRAM_MAGIC, sizeof(CACHED_PROGRAM_MAGIC));
+    header.version = CACHED_PROGRAM_VERSION;
+    header.key = key;
+
+    std::vector<char> binary(binary_size);
+    GLsizei written_size = 0;
+    glGetProgramBinary(program, binary_size, &written_size, &header.binary_format, binary.data());
+    if (checkGlErrors() || written_size <= 0) {
+        return;
+    }
+    header.binary_size = static_cast<uint32_t>(written_size);
+
+    const std::string cached_path = cachedProgramPath(name);
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(cached_path).parent_path(), error);
+
+    // write to a temporary file first, so a crash never leaves a truncated cache file behind
+    const std::string temporary_path = cached_path + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(binary.data(), written_size);
+        if (!file.good()) {
+            return;
+        }
+    }
+    std::filesystem::rename(temporary_path, cached_path, error);
+}
+
+ShaderManager::PendingProgram ShaderManager::startProgram(const std::string& name) const {
+    PendingProgram pending = {name};
+
+    const std::string vs_path = shader_path(name + ".vs.glsl");
+    const std::string fs_path = shader_path(name + ".fs.glsl");
+    std::string vs_str, fs_str;
+    if (!readFile(vs_path, vs_str) || !readFile(fs_path, fs_str)) {
+        fprintf(stderr, "Failed to load shader files %s, %s", vs_path.c_str(), fs_path.c_str());
+        return pending;
+    }
 
 #ifdef __EMSCRIPTEN__
     std::string version = "#version 300 es\n";
@@ -53,69 +194,82 @@ bool loadShader(const std::string& vs_path, const std::string& fs_path, GLuint&
     vs_str = version + vs_str;
     fs_str = version + fs_str;
 
+    // the binary is only valid for the exact same sources on the exact same driver
+    pending.cache_key = raycast::hash::fnv1a(vs_str, raycast::hash::fnv1a(fs_str, raycast::hash::fnv1a(driver_id)));
+    if (loadCachedProgram(name, pending.cache_key, pending.program)) {
+        pending.from_cache = true;
+        return pending;
+    }
+
     const char* vs_src = vs_str.c_str();
     const char* fs_src = fs_str.c_str();
     auto vs_len = (GLsizei)vs_str.size();
     auto fs_len = (GLsizei)fs_str.size();
 
-    GLuint vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vs_src, &vs_len);
-    GLuint fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fs_src, &fs_len);
+    pending.vertex = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(pending.vertex, 1, &vs_src, &vs_len);
+    pending.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(pending.fragment, 1, &fs_src, &fs_len);
+
+    // compile and link without waiting for the results, drivers that compile in the background can work on all
+    // programs at once until the first status query
+    glCompileShader(pending.vertex);
+    glCompileShader(pending.fragment);
+
+    pending.program = glCreateProgram();
+    if (program_binaries_supported) {
+        glProgramParameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glAttachShader(pending.program, pending.vertex);
+    glAttachShader(pending.program, pending.fragment);
+    glLinkProgram(pending.program);
     checkGlErrors();
 
-    // Compiling
-    if (!compileShader(vertex)) {
-        fprintf(stderr, "Vertex compilation failed");
-        return false;
+    return pending;
+}
+
+bool ShaderManager::finishProgram(const PendingProgram& pending) const {
+    if (pending.from_cache) {
+        return true;
     }
-    if (!compileShader(fragment)) {
-        fprintf(stderr, "Fragment compilation failed");
+    if (pending.program == 0) {
         return false;
     }
 
-    // Linking
-    out_program = glCreateProgram();
-    glAttachShader(out_program, vertex);
-    glAttachShader(out_program, fragment);
-    glLinkProgram(out_program);
-    checkGlErrors();
-
-    {
-        GLint is_linked = GL_FALSE;
-        glGetProgramiv(out_program, GL_LINK_STATUS, &is_linked);
-        if (is_linked == GL_FALSE) {
-            GLint log_len;
-            glGetProgramiv(out_program, GL_INFO_LOG_LENGTH, &log_len);
-            std::vector<char> log(log_len);
-            glGetProgramInfoLog(out_program, log_len, &log_len, log.data());
-            checkGlErrors();
-
-            fprintf(stderr, "Link error: %s", log.data());
-            return false;
-        }
+    bool success = true;
+    if (!checkCompileStatus(pending.vertex)) {
+        fprintf(stderr, "Vertex compilation failed");
+        success = false;
+    } else if (!checkCompileStatus(pending.fragment)) {
+        fprintf(stderr, "Fragment compilation failed");
+        success = false;
+    } else if (!checkLinkStatus(pending.program)) {
+        success = false;
     }
 
     // No need to carry this around. Keeping these objects is only useful if we
     // recycle the same shaders over and over, which we don't, so no need and
     // this is simpler.
-    glDetachShader(out_program, vertex);
-    glDetachShader(out_program, fragment);
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
+    glDetachShader(pending.program, pending.vertex);
+    glDetachShader(pending.program, pending.fragment);
+    glDeleteShader(pending.vertex);
+    glDeleteShader(pending.fragment);
     checkGlErrors();
 
+    if (!success) {
+        glDeleteProgram(pending.program);
+        return false;
+    }
+
+    writeCachedProgram(pending.name, pending.cache_key, pending.program);
     return true;
 }
 
-ShaderHandle ShaderManager::add(const std::string& name) {
-    const std::string vs_path = shader_path(name + ".vs.glsl");
-    const std::string fs_path = shader_path(name + ".fs.glsl");
-    GLuint program;
-
-    bool shader_compile_success = loadShader(vs_path, fs_path, program);
-    if (!shader_compile_success) {
-        LOG_ERROR("Failed to load shader at paths {} and {} ", vs_path, fs_path);
+ShaderHandle ShaderManager::install(const PendingProgram& pending) {
+    const std::string& name = pending.name;
+    if (!finishProgram(pending)) {
+        LOG_ERROR("Failed to load shader at paths {} and {} ", shader_path(name + ".vs.glsl"),
+                  shader_path(name + ".fs.glsl"));
         if (shaders.find(name) == shaders.end()) {
             // the shader compilation failed, and there's no existing
             // valid version of this shader program. abort.
@@ -131,8 +285,12 @@ ShaderHandle ShaderManager::add(const std::string& name) {
         glDeleteProgram(shaders[name]);
     }
 
-    shaders[name] = program;
-    return program;
+    shaders[name] = pending.program;
+    return pending.program;
+}
+
+ShaderHandle ShaderManager::add(const std::string& name) {
+    return install(startProgram(name));
 }
 
 ShaderHandle ShaderManager::get(const std::string& name) const {
@@ -145,42 +303,72 @@ ShaderHandle ShaderManager::get(const std::string& name) const {
     return shaders.at(name);
 }
 
-bool ShaderManager::update() {
-    bool shaders_updated = false;
-    const auto shaders_folder = std::filesystem::directory_entry(shader_path(""));
-    if (last_shaders_write_time != shaders_folder.last_write_time()) {
-        last_shaders_write_time = shaders_folder.last_write_time();
-        shaders_updated = true;
-        for (const auto& entry : std::filesystem::directory_iterator(shader_path(""))) {
-            const auto& path = entry.path();
-            const std::string path_string = path.stem().string();
-            const std::string shader_name = path_string.substr(0, path_string.find_first_of('.'));
-
-            if (entry.last_write_time() > write_times[path_string]) {
-                add(shader_name);
-                write_times[path_string] = entry.last_write_time();
-            }
-        }
+bool ShaderManager::update(const std::vector<std::filesystem::path>& changed_files) {
+    std::set<std::string> changed_shaders;
+    const std::filesystem::path shaders_folder = std::filesystem::path(shader_path("")).parent_path();
+    for (const auto& path : changed_files) {
+        if (path.parent_path() != shaders_folder || path.extension() != ".glsl" || !std::filesystem::exists(path))
+            continue;
+        const std::string file_name = path.filename().string();
+        changed_shaders.insert(file_name.substr(0, file_name.find_first_of('.')));
+    }
+
+    for (const std::string& shader_name : changed_shaders) {
+        add(shader_name);
     }
-    return shaders_updated;
+    return !changed_shaders.empty();
 }
 
 void ShaderManager::init() {
     if (initialized)
         return;
 
-    const auto shaders_folder = std::filesystem::directory_entry(shader_path(""));
-    last_shaders_write_time = shaders_folder.last_write_time();
+    const auto start = raycast::time::Clock::now();
+
+    driver_id = glString(GL_VENDOR) + "|" + glString(GL_RENDERER) + "|" + glString(GL_VERSION);
+#ifndef __EMSCRIPTEN__
+    // program binaries are core in OpenGL 4.1, WebGL doesn't have them at all
+    GLint major_version = 0, minor_version = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major_version);
+    glGetIntegerv(GL_MINOR_VERSION, &minor_version);
+    if (major_version * 10 + minor_version >= 41 || hasExtension("GL_ARB_get_program_binary")) {
+        GLint format_count = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+        program_binaries_supported = format_count > 0;
+    }
+
+    if (hasExtension("GL_KHR_parallel_shader_compile")) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF); // as many threads as the driver likes
+    } else if (hasExtension("GL_ARB_parallel_shader_compile")) {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+    }
+#endif
+    checkGlErrors();
 
+    std::set<std::string> names;
     for (const auto& entry : std::filesystem::directory_iterator(shader_path(""))) {
         const auto& path = entry.path();
         const std::string path_string = path.stem().string();
-        const std::string shader_name = path_string.substr(0, path_string.find_first_of('.'));
-        write_times[path_string] = entry.last_write_time();
-        if (shaders.find(shader_name) == shaders.end()) {
-            add(shader_name);
+        names.insert(path_string.substr(0, path_string.find_first_of('.')));
+    }
+
+    // kick off every compilation before checking on any of them
+    std::vector<PendingProgram> pending;
+    for (const std::string& name : names) {
+        if (shaders.find(name) == shaders.end()) {
+            pending.push_back(startProgram(name));
         }
     }
+
+    size_t cached_count = 0;
+    for (const PendingProgram& program : pending) {
+        cached_count += program.from_cache ? 1 : 0;
+        install(program);
+    }
+
+    LOG_INFO("Loaded {} shaders in {:.1f} ms ({} from the program binary cache{})", pending.size(),
+             raycast::time::ms_since(start), cached_count,
+             program_binaries_supported ? "" : ", which is not supported by this driver");
     initialized = true;
 }
 
@@ -3,14 +3,57 @@
 #include <string>
 #include <unordered_map>
 #include <filesystem>
+#include <vector>
 
 typedef GLuint ShaderHandle;
 
+/**
+ * Compiles and owns all the shader programs.
+ *
+ * Linked programs are kept in a program binary cache (see `cache_path`) where the driver supports it. Cached
+ * binaries are keyed by a hash of the shader sources and the driver's vendor, renderer and version strings, and
+ * anything that doesn't match is compiled from source again.
+ */
 class ShaderManager {
+    /**
+     * A program whose shaders were submitted for compilation but not checked on yet.
+     */
+    struct PendingProgram {
+        std::string name;
+        uint64_t cache_key = 0;
+        GLuint program = 0;
+        GLuint vertex = 0;
+        GLuint fragment = 0;
+        bool from_cache = false;
+    };
+
     bool initialized = false;
+    bool program_binaries_supported = false;
+    std::string driver_id;
     std::unordered_map<std::string, ShaderHandle> shaders;
-    std::unordered_map<std::string, std::filesystem::file_time_type> write_times;
-    std::filesystem::file_time_type last_shaders_write_time;
+
+    static std::string cachedProgramPath(const std::string& name);
+
+    bool loadCachedProgram(const std::string& name, uint64_t key, GLuint& out_program) const;
+
+    void writeCachedProgram(const std::string& name, uint64_t key, GLuint program) const;
+
+    /**
+     * Load a program from the program binary cache, or start compiling and linking it.
+     */
+    [[nodiscard]] PendingProgram startProgram(const std::string& name) const;
+
+    /**
+     * Wait for a program to be linked and check it for errors, deleting it if it failed.
+     * @return whether the program is ready to use
+     */
+    bool finishProgram(const PendingProgram& pending) const;
+
+    /**
+     * Finish a program and replace the current program with the same name with it. If it failed to compile, the
+     * current program is kept.
+     */
+    ShaderHandle install(const PendingProgram& pending);
 
     ShaderHandle add(const std::string& name);
 
@@ -26,11 +69,12 @@ class ShaderManager {
     [[nodiscard]] ShaderHandle get(const std::string& name) const;
 
     /**
-     * Reload shaders from disk if they have changed.
+     * Recompile the shaders among the given changed files.
      *
+     * @param changed_files Files that changed on disk, files outside of the shader folder are ignored
      * @return whether any shaders have been recompiled.
      */
-    bool update();
+    bool update(const std::vector<std::filesystem::path>& changed_files);
 
     ~ShaderManager();
 };
@@ -0,0 +1,127 @@
+#include "stage_profiler.hpp"
+#include "logging/log.hpp"
+
+namespace {
+const char* const STAGE_NAMES[] = {"sprites", "meshes", "particles", "text", "composite"};
+} // namespace
+
+StageProfiler::~StageProfiler() {
+#ifndef __EMSCRIPTEN__
+    for (Frame& frame : frames) {
+        if (frame.queries[0] != 0) {
+            glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+        }
+    }
+#endif
+}
+
+void StageProfiler::collect(Frame& frame, const bool wait) {
+#ifndef __EMSCRIPTEN__
+    if (!frame.pending) {
+        return;
+    }
+    frame.pending = false;
+
+    // the timestamps are written in order, so once the last one is available all of them are
+    if (!wait) {
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(frame.queries.back(), GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available != GL_TRUE) {
+            return;
+        }
+    }
+
+    std::array<GLuint64, STAGE_COUNT + 1> timestamps = {};
+    for (size_t i = 0; i < timestamps.size(); i++) {
+        glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &timestamps[i]);
+    }
+    for (size_t stage = 0; stage < STAGE_COUNT; stage++) {
+        gpu_total_ms[stage] += static_cast<double>(timestamps[stage + 1] - timestamps[stage]) / 1e6;
+    }
+    gpu_frames++;
+#else
+    (void)frame;
+    (void)wait;
+#endif
+}
+
+void StageProfiler::beginFrame() {
+    if (!enabled) {
+        return;
+    }
+
+#ifndef __EMSCRIPTEN__
+    Frame& frame = frames[current_frame];
+    if (frame.queries[0] == 0) {
+        glGenQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+    }
+    // the queries of this frame were last used FRAME_COUNT frames ago
+    collect(frame, false);
+    glQueryCounter(frame.queries[0], GL_TIMESTAMP);
+#endif
+    if (cpu_frames == 0) {
+        container_stats_start = container_allocation_stats;
+    }
+    stage_start = raycast::time::Clock::now();
+}
+
+void StageProfiler::endStage(const Stage stage, const CullStats& cull_stats) {
+    if (!enabled) {
+        return;
+    }
+
+    cull_totals[stage].drawn += cull_stats.drawn;
+    cull_totals[stage].culled += cull_stats.culled;
+
+#ifndef __EMSCRIPTEN__
+    glQueryCounter(frames[current_frame].queries[stage + 1], GL_TIMESTAMP);
+#endif
+    const auto now = raycast::time::Clock::now();
+    cpu_total_ms[stage] +=
+        static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(now - stage_start).count()) / 1000.0;
+    stage_start = now;
+}
+
+void StageProfiler::endFrame() {
+    if (!enabled) {
+        return;
+    }
+
+#ifndef __EMSCRIPTEN__
+    frames[current_frame].pending = true;
+    current_frame = (current_frame + 1) % FRAME_COUNT;
+#endif
+    cpu_frames++;
+}
+
+void StageProfiler::finish() {
+    if (!enabled || cpu_frames == 0) {
+        return;
+    }
+
+    for (Frame& frame : frames) {
+        collect(frame, true);
+    }
+
+    LOG_INFO("Render stage times over {} frames ({} with GPU times), average per frame:", cpu_frames, gpu_frames);
+    double cpu_sum_ms = 0;
+    double gpu_sum_ms = 0;
+    for (size_t stage = 0; stage < STAGE_COUNT; stage++) {
+        const double cpu_ms = cpu_total_ms[stage] / static_cast<double>(cpu_frames);
+        const double gpu_ms = gpu_frames > 0 ? gpu_total_ms[stage] / static_cast<double>(gpu_frames) : 0.0;
+        cpu_sum_ms += cpu_ms;
+        gpu_sum_ms += gpu_ms;
+        const double drawn = static_cast<double>(cull_totals[stage].drawn) / static_cast<double>(cpu_frames);
+        const double culled = static_cast<double>(cull_totals[stage].culled) / static_cast<double>(cpu_frames);
+        LOG_INFO("  {:<10} CPU {:8.3f} ms  GPU {:8.3f} ms  drawn {:7.1f}  culled {:7.1f}", STAGE_NAMES[stage], cpu_ms,
+                 gpu_ms, drawn, culled);
+    }
+    LOG_INFO("  {:<10} CPU {:8.3f} ms  GPU {:8.3f} ms", "total", cpu_sum_ms, gpu_sum_ms);
+
+    const double frames = static_cast<double>(cpu_frames);
+    const size_t heap_allocations = container_allocation_stats.heap_allocations - container_stats_start.heap_allocations;
+    const size_t vector_growths = container_allocation_stats.vector_growths - container_stats_start.vector_growths;
+    LOG_INFO("Component containers: {:.2f} heap allocations and {:.2f} vector growths per frame, {} KiB pooled",
+             static_cast<double>(heap_allocations) / frames, static_cast<double>(vector_growths) / frames,
+             container_allocation_stats.pooled_bytes / 1024);
+}
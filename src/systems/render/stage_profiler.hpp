@@ -0,0 +1,87 @@
+#pragma once
+#include "block_pool.hpp"
+#include "common.hpp"
+#include "util.hpp"
+#include "utils/time.hpp"
+
+#include <array>
+
+/**
+ * Measures the CPU and GPU time of every render stage, and adds them up over all profiled frames along with how many
+ * entities every stage drew and culled.
+ *
+ * GPU times come from timestamp queries written between the stages. Like `GpuTimer`, results are collected a few
+ * frames late and are dropped rather than waited for, except by `finish`. Timestamps can be written while a
+ * `GpuTimer` is running, so both can be used together. On the web build there are no timer queries, so only CPU
+ * times are reported there.
+ *
+ * The heap traffic of the ECS component containers over the profiled frames is reported along with the stage times,
+ * see `ContainerAllocationStats`.
+ */
+class StageProfiler {
+  public:
+    enum Stage {
+        SPRITES,
+        MESHES,
+        PARTICLES,
+        TEXT,
+        COMPOSITE,
+        STAGE_COUNT,
+    };
+
+  private:
+    static constexpr size_t FRAME_COUNT = 4;
+
+    /** Timestamps taken at the start of a frame and after every stage */
+    struct Frame {
+        std::array<GLuint, STAGE_COUNT + 1> queries = {};
+        bool pending = false;
+    };
+
+    bool enabled = false;
+
+    std::array<Frame, FRAME_COUNT> frames;
+    size_t current_frame = 0;
+    raycast::time::Clock::time_point stage_start;
+
+    std::array<double, STAGE_COUNT> cpu_total_ms = {};
+    std::array<double, STAGE_COUNT> gpu_total_ms = {};
+    std::array<CullStats, STAGE_COUNT> cull_totals = {};
+    size_t cpu_frames = 0;
+    size_t gpu_frames = 0;
+
+    /** Container allocation stats when the first profiled frame started */
+    ContainerAllocationStats container_stats_start;
+
+    /**
+     * Add the GPU times of a frame to the totals.
+     * @param wait Whether to wait for the results instead of dropping them if they are not available yet
+     */
+    void collect(Frame& frame, bool wait);
+
+  public:
+    StageProfiler() = default;
+    StageProfiler(const StageProfiler&) = delete;
+    StageProfiler& operator=(const StageProfiler&) = delete;
+    ~StageProfiler();
+
+    /**
+     * Start or stop profiling. While disabled, all other methods do nothing.
+     */
+    void setEnabled(bool enabled_arg) { enabled = enabled_arg; }
+
+    void beginFrame();
+
+    /**
+     * Mark the end of the given stage, which started at the end of the previous one (or at `beginFrame`).
+     * @param cull_stats What the stage drew and culled this frame
+     */
+    void endStage(Stage stage, const CullStats& cull_stats = {});
+
+    void endFrame();
+
+    /**
+     * Wait for the GPU times of all profiled frames and log the average time of every stage.
+     */
+    void finish();
+};
@@ -18,6 +18,38 @@ void CompositorStage::createVertexAndIndexBuffers() {
     checkGlErrors();
 }
 
+namespace {
+/** Number of mip levels the bloom is blurred over for each `BloomQuality` */
+constexpr int BLOOM_MIP_COUNTS[] = {0, 3, 4, 5};
+
+/** Seconds worth of frames between bloom timing readouts */
+constexpr int TIMING_LOG_INTERVAL_FRAMES = 5 * 60;
+
+// post processor shader modes
+constexpr int MODE_PREFILTER = 0;
+constexpr int MODE_DOWNSAMPLE = 1;
+constexpr int MODE_UPSAMPLE = 2;
+constexpr int MODE_COMPOSITE = 3;
+} // namespace
+
+TextureHandle CompositorStage::createRenderTarget(const ivec2 size, const GLint filter, GLuint& out_frame_buffer) {
+    glGenFramebuffers(1, &out_frame_buffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, out_frame_buffer);
+
+    TextureHandle texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, size.x, size.y, 0, GL_RGBA, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+
+    checkGlErrors();
+    return texture;
+}
+
 void CompositorStage::createTextures() {
     // create new render textures and bind it to our new framebuffer
     glGenFramebuffers(1, &frame_buffer);
@@ -29,28 +61,48 @@ void CompositorStage::createTextures() {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, composited_texture, 0);
 
-    glGenFramebuffers(1, &bloom_buffer0);
-    glBindFramebuffer(GL_FRAMEBUFFER, bloom_buffer0);
-    glGenTextures(1, &bloom_tex0);
-    glBindTexture(GL_TEXTURE_2D, bloom_tex0);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, bloom_pass_width, bloom_pass_height, 0, GL_RGBA, GL_FLOAT, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // the world is drawn at its native resolution, so that is all the resolution the bloom composite needs
+    bloom_texture = createRenderTarget({native_width, native_height}, GL_NEAREST, bloom_buffer);
 
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, bloom_tex0, 0);
+    glGenSamplers(1, &linear_sampler);
+    glSamplerParameteri(linear_sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glSamplerParameteri(linear_sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glSamplerParameteri(linear_sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glSamplerParameteri(linear_sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-    glGenFramebuffers(1, &bloom_buffer1);
-    glBindFramebuffer(GL_FRAMEBUFFER, bloom_buffer1);
-    glGenTextures(1, &bloom_tex1);
-    glBindTexture(GL_TEXTURE_2D, bloom_tex1);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, bloom_pass_width, bloom_pass_height, 0, GL_RGBA, GL_FLOAT, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, bloom_tex1, 0);
+    createBloomMips();
+}
+
+void CompositorStage::createBloomMips() {
+    releaseBloomMips();
+
+    // the first mip has the world's native resolution, everything below it is a progressively wider blur
+    ivec2 size = {native_width, native_height};
+    for (int i = 0; i < BLOOM_MIP_COUNTS[static_cast<int>(bloom_quality)]; i++) {
+        BloomMip mip = {size};
+        mip.texture = createRenderTarget(size, GL_LINEAR, mip.frame_buffer);
+        bloom_mips.push_back(mip);
+        size = max(size / 2, ivec2(1));
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void CompositorStage::releaseBloomMips() {
+    for (BloomMip& mip : bloom_mips) {
+        glDeleteFramebuffers(1, &mip.frame_buffer);
+        glDeleteTextures(1, &mip.texture);
+    }
+    bloom_mips.clear();
+}
+
+void CompositorStage::setBloomQuality(const BloomQuality quality) {
+    if (quality == bloom_quality) {
+        return;
+    }
+    LOG_INFO("Bloom quality set to {}", static_cast<int>(quality));
+    bloom_quality = quality;
+    createBloomMips();
 }
 
 void CompositorStage::init(GLFWwindow* window_arg) {
@@ -65,6 +117,18 @@ void CompositorStage::init(GLFWwindow* window_arg) {
     createVertexAndIndexBuffers();
     createTextures();
 
+    if (window == nullptr) {
+        glGenFramebuffers(1, &offscreen_buffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, offscreen_buffer);
+        glGenTextures(1, &offscreen_texture);
+        glBindTexture(GL_TEXTURE_2D, offscreen_texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, window_width_px, window_height_px, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                     nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, offscreen_texture, 0);
+    }
+
     updateShaders();
 
     // create vao
@@ -79,8 +143,8 @@ void CompositorStage::setupTextures() const {
         "ui_text",
     };
 
-    static GLuint textures[] = {
-        bloom_tex1,
+    const GLuint textures[] = {
+        bloom_mips.empty() ? world_texture : bloom_texture,
         ui_texture,
         world_text_texture,
         ui_text_texture
@@ -112,7 +176,12 @@ void CompositorStage::prepare() const {
  * Adapted from https://gamedev.stackexchange.com/a/54906 by 'aaaaaaaaaaaa'
  */
 void CompositorStage::updateViewport() const {
-    glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
+    if (window != nullptr) {
+        glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
+    } else {
+        framebuffer_width = window_width_px;
+        framebuffer_height = window_height_px;
+    }
 
 #ifdef __EMSCRIPTEN__
     glViewport(0, 0, framebuffer_width, framebuffer_height);
@@ -134,7 +203,7 @@ void CompositorStage::composite() const {
     glUseProgram(compositor_shader);
 
     updateViewport();
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, offscreen_buffer);
 
     // Set the vertex position and vertex texture coordinates (both stored in the same VBO)
     GLint position_location = glGetAttribLocation(compositor_shader, "in_position");
@@ -150,70 +219,145 @@ void CompositorStage::composite() const {
     checkGlErrors();
 }
 
-void CompositorStage::bloomBrightnessPass() const {
-    glViewport(0, 0, bloom_pass_width, bloom_pass_height);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, bloom_buffer1);
-    glClear(GL_COLOR_BUFFER_BIT);
+void CompositorStage::bloomPrefilterPass() {
+    const BloomMip& target = bloom_mips.front();
+    glViewport(0, 0, target.size.x, target.size.y);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.frame_buffer);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, bloom_buffer0);
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, world_texture);
-    setUniformInt(post_processor_shader, "mode", 0);
+    setUniformFloatVec2(post_processor_shader, "texel_size", 1.f / vec2(native_width, native_height));
+    setUniformInt(post_processor_shader, "mode", MODE_PREFILTER);
 
-    glClear(GL_COLOR_BUFFER_BIT);
     glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_SHORT, nullptr);
 }
 
-void CompositorStage::bloomBlurPass() const {
-    constexpr int blur_passes = 4;
+void CompositorStage::bloomDownsamplePass() {
+    glActiveTexture(GL_TEXTURE0);
+    setUniformInt(post_processor_shader, "mode", MODE_DOWNSAMPLE);
+
+    for (size_t i = 1; i < bloom_mips.size(); i++) {
+        const BloomMip& source = bloom_mips[i - 1];
+        const BloomMip& target = bloom_mips[i];
+        glViewport(0, 0, target.size.x, target.size.y);
+        glBindFramebuffer(GL_FRAMEBUFFER, target.frame_buffer);
+        glBindTexture(GL_TEXTURE_2D, source.texture);
+        setUniformFloatVec2(post_processor_shader, "texel_size", 1.f / vec2(source.size));
+
+        glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_SHORT, nullptr);
+    }
+}
 
-    glViewport(0, 0, bloom_pass_width, bloom_pass_height);
+void CompositorStage::bloomUpsamplePass() {
     glActiveTexture(GL_TEXTURE0);
+    setUniformInt(post_processor_shader, "mode", MODE_UPSAMPLE);
+
+    // every mip accumulates the blurred versions of all the mips below it
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+
+    for (size_t i = bloom_mips.size() - 1; i > 0; i--) {
+        const BloomMip& source = bloom_mips[i];
+        const BloomMip& target = bloom_mips[i - 1];
+        glViewport(0, 0, target.size.x, target.size.y);
+        glBindFramebuffer(GL_FRAMEBUFFER, target.frame_buffer);
+        glBindTexture(GL_TEXTURE_2D, source.texture);
+        setUniformFloatVec2(post_processor_shader, "texel_size", 1.f / vec2(source.size));
 
-    for (int i = 0; i < blur_passes; i++) {
-        glBindFramebuffer(GL_FRAMEBUFFER, i % 2 == 0 ? bloom_buffer1 : bloom_buffer0);
-        glBindTexture(GL_TEXTURE_2D, i % 2 == 0 ? bloom_tex0 : bloom_tex1);
-        setUniformInt(post_processor_shader, "mode", (i % 2) + 1);
         glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_SHORT, nullptr);
     }
+
+    glDisable(GL_BLEND);
 }
 
-void CompositorStage::bloomComposite() const {
-    glViewport(0, 0, bloom_pass_width, bloom_pass_height);
-    glBindFramebuffer(GL_FRAMEBUFFER, bloom_buffer1);
+void CompositorStage::bloomComposite() {
+    glViewport(0, 0, native_width, native_height);
+    glBindFramebuffer(GL_FRAMEBUFFER, bloom_buffer);
 
     setUniformInt(post_processor_shader, "input1", 0);
     setUniformInt(post_processor_shader, "input2", 1);
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, bloom_tex0);
+    glBindTexture(GL_TEXTURE_2D, bloom_mips.front().texture);
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, world_texture);
 
-    setUniformInt(post_processor_shader, "mode", 3);
+    // every mip adds about as much light as the bright parts of the world had to begin with
+    setUniformFloat(post_processor_shader, "bloom_strength", 1.f / static_cast<float>(bloom_mips.size()));
+    setUniformInt(post_processor_shader, "mode", MODE_COMPOSITE);
 
-    glClear(GL_COLOR_BUFFER_BIT);
     glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_SHORT, nullptr);
 }
 
-void CompositorStage::postProcess() const {
+void CompositorStage::postProcess() {
+    if (bloom_mips.empty()) {
+        return;
+    }
+
     glUseProgram(post_processor_shader);
 
-    setUniformFloatVec2(post_processor_shader, "screen_size", vec2(upscaled_width, upscaled_height));
+    // Set the vertex position (the texture coordinates are derived from it)
+    GLint position_location = glGetAttribLocation(post_processor_shader, "in_position");
+    glEnableVertexAttribArray(position_location);
+    glVertexAttribPointer(position_location, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void*)nullptr);
+
+    setUniformInt(post_processor_shader, "input1", 0);
+
+    // the world texture is nearest filtered for the crisp pixel art look, but the bloom filters rely on bilinear
+    // filtering to get four texels out of every tap
+    glBindSampler(0, linear_sampler);
+
+    bloom_timers[PREFILTER].begin();
+    bloomPrefilterPass();
+    bloom_timers[PREFILTER].end();
 
-    bloomBrightnessPass();
-    bloomBlurPass();
+    bloom_timers[DOWNSAMPLE].begin();
+    bloomDownsamplePass();
+    bloom_timers[DOWNSAMPLE].end();
+
+    bloom_timers[UPSAMPLE].begin();
+    bloomUpsamplePass();
+    bloom_timers[UPSAMPLE].end();
+
+    glBindSampler(0, 0);
+
+    bloom_timers[COMPOSITE].begin();
     bloomComposite();
+    bloom_timers[COMPOSITE].end();
 
     checkGlErrors();
+
+    if (++frames_since_timing_log >= TIMING_LOG_INTERVAL_FRAMES) {
+        frames_since_timing_log = 0;
+        LOG_DEBUG("Bloom GPU time ({} mips): prefilter {:.3f} ms, downsample {:.3f} ms, upsample {:.3f} ms, "
+                  "composite {:.3f} ms",
+                  bloom_mips.size(), bloom_timers[PREFILTER].milliseconds(), bloom_timers[DOWNSAMPLE].milliseconds(),
+                  bloom_timers[UPSAMPLE].milliseconds(), bloom_timers[COMPOSITE].milliseconds());
+    }
 }
 
-void CompositorStage::draw() const {
+void CompositorStage::draw() {
     prepare();
     postProcess();
     composite();
 }
 
+void CompositorStage::readPixels(std::vector<uint8_t>& out_pixels, ivec2& out_size) const {
+    out_size = {framebuffer_width, framebuffer_height};
+    const size_t row_size = static_cast<size_t>(out_size.x) * 4;
+    out_pixels.resize(row_size * out_size.y);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, offscreen_buffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, out_size.x, out_size.y, GL_RGBA, GL_UNSIGNED_BYTE, out_pixels.data());
+
+    // OpenGL returns the bottom row first
+    for (int y = 0; y < out_size.y / 2; y++) {
+        std::swap_ranges(out_pixels.begin() + y * row_size, out_pixels.begin() + (y + 1) * row_size,
+                         out_pixels.end() - (y + 1) * row_size);
+    }
+    checkGlErrors();
+}
+
 void CompositorStage::updateShaders() {
     compositor_shader = shader_manager.get("compositor");
     post_processor_shader = shader_manager.get("post_processor");
@@ -223,5 +367,12 @@ CompositorStage::~CompositorStage() {
     glDeleteBuffers(1, &vbo);
     glDeleteBuffers(1, &ibo);
 
+    releaseBloomMips();
+    glDeleteFramebuffers(1, &bloom_buffer);
+    glDeleteTextures(1, &bloom_texture);
+    glDeleteSamplers(1, &linear_sampler);
+    glDeleteFramebuffers(1, &offscreen_buffer);
+    glDeleteTextures(1, &offscreen_texture);
+
     checkGlErrors();
 }
@@ -1,8 +1,25 @@
 #pragma once
 #include "common.hpp"
+#include "gpu_timer.hpp"
 #include "shader.hpp"
 #include "texture.hpp"
 
+#include <array>
+
+/**
+ * How much work goes into bloom. Higher quality levels blur over more mip levels, which widens the glow.
+ * Bloom can be turned off entirely for slow (e.g. software rendered) machines.
+ */
+enum class BloomQuality {
+    OFF = 0,
+    LOW = 1,
+    MEDIUM = 2,
+    HIGH = 3,
+};
+
+/** Names of the `BloomQuality` levels as shown in the settings menu */
+inline const char* const BLOOM_QUALITY_NAMES[] = {"Off", "Low", "Medium", "High"};
+
 /**
  * Composites all other frames into one final frame.
  *
@@ -20,9 +37,24 @@ class CompositorStage {
     GLuint ibo = 0;
     GLuint vao = 0;
 
+    /**
+     * One level of the bloom mip chain, each level is half the size of the previous one.
+     */
+    struct BloomMip {
+        ivec2 size;
+        GLuint frame_buffer = 0;
+        TextureHandle texture = 0;
+    };
+
+    enum BloomPass {
+        PREFILTER,
+        DOWNSAMPLE,
+        UPSAMPLE,
+        COMPOSITE,
+        BLOOM_PASS_COUNT,
+    };
+
     GLuint frame_buffer = 0;
-    GLuint bloom_buffer0 = 0;
-    GLuint bloom_buffer1 = 0;
 
     TextureHandle world_texture = 0;
     TextureHandle ui_texture = 0;
@@ -31,20 +63,39 @@ class CompositorStage {
 
     TextureHandle composited_texture = 0;
 
-    TextureHandle bloom_tex0 = 0;
-    TextureHandle bloom_tex1 = 0;
+    BloomQuality bloom_quality = BloomQuality::HIGH;
+    std::vector<BloomMip> bloom_mips;
+
+    /** The world with bloom applied, this is what gets composited instead of the world texture */
+    GLuint bloom_buffer = 0;
+    TextureHandle bloom_texture = 0;
+
+    /** Samples the world texture with bilinear filtering during the bloom passes, it is nearest filtered otherwise */
+    GLuint linear_sampler = 0;
+
+    std::array<GpuTimer, BLOOM_PASS_COUNT> bloom_timers;
+    int frames_since_timing_log = 0;
 
     ShaderHandle compositor_shader = 0;
     ShaderHandle post_processor_shader = 0;
 
-    int bloom_pass_width = native_width * 2;
-    int bloom_pass_height = native_height * 2;
-
+    /** Null when rendering headless, the final frame then goes to `offscreen_buffer` instead of the window */
     GLFWwindow* window = nullptr;
 
+    GLuint offscreen_buffer = 0;
+    TextureHandle offscreen_texture = 0;
+
     void createVertexAndIndexBuffers();
     void createTextures();
 
+    /**
+     * Create the bloom mip chain for the current quality level, replacing the previous one.
+     */
+    void createBloomMips();
+    void releaseBloomMips();
+
+    static TextureHandle createRenderTarget(ivec2 size, GLint filter, GLuint& out_frame_buffer);
+
     void setupTextures() const;
     void prepare() const;
     void updateViewport() const;
@@ -52,6 +103,8 @@ class CompositorStage {
   public:
     /**
      * Initialize the state for the compositing stage.
+     * @param window_arg The window to present to, or null to composite into an offscreen framebuffer of the window's
+     * size instead
      */
     void init(GLFWwindow* window_arg);
 
@@ -59,13 +112,36 @@ class CompositorStage {
      * Composite all frames from this pipeline iteration into a single frame and apply scaling.
      */
     void composite() const;
-    void bloomBrightnessPass() const;
-    void bloomBlurPass() const;
-    void bloomComposite() const;
-    void postProcess() const;
-    void draw() const;
+
+    /**
+     * Keep the bright parts of the world and downsample them into the first bloom mip.
+     */
+    void bloomPrefilterPass();
+
+    /**
+     * Downsample every bloom mip into the next smaller one with a 13-tap filter.
+     */
+    void bloomDownsamplePass();
+
+    /**
+     * Walk back up the mip chain, adding a tent-filtered upsample of every mip onto the next larger one.
+     */
+    void bloomUpsamplePass();
+
+    void bloomComposite();
+    void postProcess();
+    void draw();
 
     void updateShaders();
 
+    void setBloomQuality(BloomQuality quality);
+
+    [[nodiscard]] BloomQuality getBloomQuality() const { return bloom_quality; }
+
+    /**
+     * Read back the last composited frame as 8-bit RGBA, row by row starting from the top.
+     */
+    void readPixels(std::vector<uint8_t>& out_pixels, ivec2& out_size) const;
+
     ~CompositorStage();
 };
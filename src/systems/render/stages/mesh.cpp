@@ -23,38 +23,84 @@ void MeshStage::createFrame() {
     checkGlErrors();
 }
 
-void MeshStage::addMesh(const Entity& entity) {
-    const Mesh& mesh = registry.meshes.get(entity);
+MeshBuffers& MeshStage::addMesh(const Mesh& mesh) {
+    MeshBuffers& buffers = mesh_buffers[mesh.name];
 
-    GLuint vbo, ibo, vao;
+    glGenVertexArrays(1, &buffers.vao);
+    glGenBuffers(1, &buffers.vbo);
+    glGenBuffers(1, &buffers.ibo);
 
-    // create a new vao
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-    glGenBuffers(1, &ibo);
-
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.vbo);
     glBufferData(GL_ARRAY_BUFFER, sizeof(mesh.vertices[0]) * mesh.vertices.size(), mesh.vertices.data(),
                  GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.ibo);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(mesh.vertex_indices[0]) * mesh.vertex_indices.size(),
                  mesh.vertex_indices.data(), GL_STATIC_DRAW);
+    buffers.index_count = static_cast<GLsizei>(mesh.vertex_indices.size());
+
+    initVAO(buffers);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    checkGlErrors();
+
+    return buffers;
+}
+
+void MeshStage::releaseMesh(MeshBuffers& buffers) {
+    glDeleteVertexArrays(1, &buffers.vao);
+    glDeleteBuffers(1, &buffers.vbo);
+    glDeleteBuffers(1, &buffers.ibo);
+
+    checkGlErrors();
+}
+
+/**
+ * Set up the vertex attributes of a mesh's VAO. The vertex buffer holds per-vertex data, while the instance data,
+ * one `MeshInstanceGPUData` per entity drawn with this mesh, is streamed every frame, see `bindInstanceAttributes`.
+ */
+void MeshStage::initVAO(const MeshBuffers& buffers) const {
+    glBindVertexArray(buffers.vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.ibo);
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.vbo);
+    glEnableVertexAttribArray(position_aloc);
+    glVertexAttribPointer(position_aloc, 3, GL_FLOAT, GL_FALSE, sizeof(ColoredVertex), (void*)nullptr);
+    glEnableVertexAttribArray(color_aloc);
+    glVertexAttribPointer(color_aloc, 3, GL_FLOAT, GL_FALSE, sizeof(ColoredVertex), (void*)sizeof(vec3));
+
+    // a mat3 attribute takes up three consecutive locations, one per column
+    for (GLint column = 0; column < 3; column++) {
+        glEnableVertexAttribArray(instance_transform_aloc + column);
+        glVertexAttribDivisor(instance_transform_aloc + column, 1);
+    }
+    glEnableVertexAttribArray(instance_light_aloc);
+    glVertexAttribDivisor(instance_light_aloc, 1);
 
     checkGlErrors();
+}
 
-    vaos[entity] = vao;
-    vbos[entity] = vbo;
-    ibos[entity] = ibo;
+/**
+ * Point the instance attributes of the bound VAO at instances pushed into the streaming buffer.
+ */
+void MeshStage::bindInstanceAttributes(const GLintptr offset) const {
+    for (GLint column = 0; column < 3; column++) {
+        glVertexAttribPointer(instance_transform_aloc + column, 3, GL_FLOAT, GL_FALSE, sizeof(MeshInstanceGPUData),
+                              (void*)(offset + offsetof(MeshInstanceGPUData, transform) + column * sizeof(vec3)));
+    }
+    glVertexAttribPointer(instance_light_aloc, 3, GL_FLOAT, GL_FALSE, sizeof(MeshInstanceGPUData),
+                          (void*)(offset + offsetof(MeshInstanceGPUData, light_up)));
 }
 
 /**
- * Update uniform variables for the shader program based on the given entity and texture.
+ * Update uniform variables that are shared by every mesh.
  */
-void MeshStage::activateShader(const Entity& entity) {
+void MeshStage::activateShader() const {
     glUseProgram(shader);
-    setUniformFloatVec3(shader, "fcolor", vec3(1.0f, 1.0f, 1.0f));
-    setUniformFloatMat3(shader, "projection", projection_matrix);
+    glUniform3f(fcolor_uloc, 1.0f, 1.0f, 1.0f);
+    glUniformMatrix3fv(projection_uloc, 1, GL_FALSE, (float*)&projection_matrix);
 }
 
 /**
@@ -69,90 +115,109 @@ void MeshStage::prepareDraw() const {
     glDisable(GL_DEPTH_TEST);
 }
 
-void MeshStage::activateMesh(const Entity& mesh_entity) {
-    if (vaos.find(mesh_entity) == vaos.end()) {
-        addMesh(mesh_entity);
-    }
-
-    // Setting active vertex and index buffers
-    GLuint vao = vaos.at(mesh_entity);
-    GLuint vbo = vbos.at(mesh_entity);
-    GLuint ibo = ibos.at(mesh_entity);
-
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-
-    GLint position_location = glGetAttribLocation(shader, "in_position");
-    GLint color_location = glGetAttribLocation(shader, "in_color");
-    assert(color_location >= 0);
-
-    glEnableVertexAttribArray(position_location);
-    glVertexAttribPointer(position_location, 3, GL_FLOAT, GL_FALSE, sizeof(ColoredVertex), (void*)nullptr);
-    glEnableVertexAttribArray(color_location);
-    glVertexAttribPointer(color_location, 3, GL_FLOAT, GL_FALSE, sizeof(ColoredVertex), (void*)sizeof(vec3));
-
-    checkGlErrors();
-}
-
 /**
- * Draw a given Entity which has a `Motion` and `Material`.
- * @param entity The sprite to render
+ * Draw every instance gathered for a mesh asset with a single instanced draw call.
  */
-void MeshStage::drawMesh(const Entity& entity) {
-    const auto& [position, angle, velocity, scale] = registry.motions.get(entity);
-
-    Transform transform;
-    transform.translate(position);
-    transform.rotate(angle);
-    transform.scale(scale);
-
-    // Setting uniform values to the currently bound program
-    setUniformFloatMat3(shader, "transform", transform.mat);
-
-    // Checking to see if we should light up this mesh 
-    GLint light_up_uloc = glGetUniformLocation(shader, "light_up");
-    GLint is_minisun_uloc = glGetUniformLocation(shader, "is_minisun");
-    GLint light_level_uloc = glGetUniformLocation(shader, "light_level");
-    assert(light_up_uloc >= 0);
-    assert(is_minisun_uloc >= 0);
-    assert(light_level_uloc >= 0);
-    if (registry.minisuns.has(entity)) {
-        glUniform1i(light_up_uloc, 0);
-        glUniform1i(is_minisun_uloc, 1);
-        glUniform1f(light_level_uloc, registry.minisuns.get(entity).light_level_percentage);
-    } else {
-        glUniform1i(light_up_uloc, registry.litEntities.has(entity));
-        glUniform1i(is_minisun_uloc, 0);
-        glUniform1f(light_level_uloc, 0.0f);
-    }
-    
+void MeshStage::drawMesh(MeshBuffers& buffers) {
+    const auto instance_count = static_cast<GLsizei>(buffers.instances.size());
+
+    glBindVertexArray(buffers.vao);
+    bindInstanceAttributes(streaming_buffer.push(buffers.instances));
 
-    // Drawing of num_indices/3 triangles specified in the index buffer
-    GLint size = 0;
-    glGetBufferParameteriv(GL_ELEMENT_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
-    GLsizei num_indices = size / sizeof(uint16_t);
-    glDrawElements(GL_TRIANGLES, num_indices, GL_UNSIGNED_SHORT, nullptr);
+    glDrawElementsInstanced(GL_TRIANGLES, buffers.index_count, GL_UNSIGNED_SHORT, nullptr, instance_count);
 
     checkGlErrors();
 }
 
 void MeshStage::draw() {
     prepareDraw();
+    activateShader();
 
-    for (const Entity& mesh_entity : registry.meshes.entities) {
-        activateShader(mesh_entity);
-        activateMesh(mesh_entity);
-        drawMesh(mesh_entity);
+    for (auto& [name, buffers] : mesh_buffers) {
+        buffers.instances.clear();
+        buffers.ref_count = 0;
     }
+
+    // gather the instance data of every mesh entity, grouped by the asset it uses
+    cull_stats = {};
+    for (size_t i = 0; i < registry.meshes.size(); i++) {
+        const Entity& entity = registry.meshes.entities[i];
+        const Mesh& mesh = registry.meshes.components[i];
+        const Motion& motion = registry.motions.get(entity);
+        const auto& [position, angle, velocity, scale] = motion;
+
+        auto it = mesh_buffers.find(mesh.name);
+        MeshBuffers& buffers = it != mesh_buffers.end() ? it->second : addMesh(mesh);
+
+        // the buffers are still looked up, so that meshes which are only off screen for now are kept around
+        if (!isOnScreen(motion)) {
+            buffers.ref_count++;
+            cull_stats.culled++;
+            continue;
+        }
+        cull_stats.drawn++;
+
+        Transform transform;
+        transform.translate(position);
+        transform.rotate(angle);
+        transform.scale(scale);
+
+        // Checking to see if we should light up this mesh
+        MeshInstanceGPUData instance = {transform.mat, 0.0f, 0.0f, 0.0f};
+        if (registry.minisuns.has(entity)) {
+            instance.is_minisun = 1.0f;
+            instance.light_level = registry.minisuns.get(entity).light_level_percentage;
+        } else {
+            instance.light_up = registry.litEntities.has(entity) ? 1.0f : 0.0f;
+        }
+        buffers.instances.push_back(instance);
+    }
+
+    for (auto it = mesh_buffers.begin(); it != mesh_buffers.end();) {
+        MeshBuffers& buffers = it->second;
+        buffers.ref_count += buffers.instances.size();
+
+        // no entity uses this mesh anymore (e.g. after a scene change), so free its buffers
+        if (buffers.ref_count == 0) {
+            releaseMesh(buffers);
+            it = mesh_buffers.erase(it);
+            continue;
+        }
+
+        if (!buffers.instances.empty()) {
+            drawMesh(buffers);
+        }
+        ++it;
+    }
+
+    glBindVertexArray(0);
 }
 
 void MeshStage::updateShaders() {
     shader = shader_manager.get("mesh");
-}
 
+    projection_uloc = glGetUniformLocation(shader, "projection");
+    fcolor_uloc = glGetUniformLocation(shader, "fcolor");
+    position_aloc = glGetAttribLocation(shader, "in_position");
+    color_aloc = glGetAttribLocation(shader, "in_color");
+    instance_transform_aloc = glGetAttribLocation(shader, "instance_transform");
+    instance_light_aloc = glGetAttribLocation(shader, "instance_light");
+    assert(color_aloc >= 0);
+    assert(instance_transform_aloc >= 0);
+    assert(instance_light_aloc >= 0);
+
+    // attribute locations may have moved after a shader reload
+    for (const auto& [name, buffers] : mesh_buffers) {
+        initVAO(buffers);
+    }
+    glBindVertexArray(0);
+}
 
 MeshStage::~MeshStage() {
+    for (auto& [name, buffers] : mesh_buffers) {
+        releaseMesh(buffers);
+    }
+
     glDeleteTextures(1, &frame_texture);
     glDeleteFramebuffers(1, &frame_buffer);
 
@@ -4,6 +4,48 @@
 #include "shader.hpp"
 #include "util.hpp"
 
+/**
+ * Per-instance data for a single mesh entity that will be sent to the GPU.
+ * Must follow OpenGL's alignment requirements.
+ */
+#pragma pack(push, 1)
+struct MeshInstanceGPUData {
+    mat3 transform;
+    float light_up;
+    float is_minisun;
+    float light_level;
+};
+#pragma pack(pop)
+
+/**
+ * GPU buffers for a single mesh asset. These are shared by every entity that uses the same mesh file,
+ * and stay alive across scene reloads for as long as at least one entity references the asset.
+ */
+struct MeshBuffers {
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLuint ibo = 0;
+    GLsizei index_count = 0;
+
+    /**
+     * Number of live mesh entities referencing this asset. Recomputed every frame; the buffers are released
+     * as soon as this drops to zero.
+     */
+    size_t ref_count = 0;
+
+    /**
+     * Instance data gathered for the current frame. Kept around so its capacity can be reused.
+     */
+    std::vector<MeshInstanceGPUData> instances;
+};
+
+/**
+ * Renders meshes into the world.
+ *
+ * Vertex and index buffers are uploaded once per mesh asset (keyed by the mesh's file path) rather than per entity.
+ * Every entity that shares an asset is then drawn with a single instanced draw call, with the transform and
+ * lighting state of each entity streamed through the shared `streaming_buffer`.
+ */
 class MeshStage {
     /**
      * Intermediate frame texture. All drawing for this stage will be output to this texture
@@ -12,32 +54,45 @@ class MeshStage {
     GLuint frame_buffer = 0;
     ShaderHandle shader = 0;
 
+    GLint projection_uloc = -1;
+    GLint fcolor_uloc = -1;
+    GLint position_aloc = -1;
+    GLint color_aloc = -1;
+    GLint instance_transform_aloc = -1;
+    GLint instance_light_aloc = -1;
+
     mat3 projection_matrix = createProjectionMatrix();
 
-    std::unordered_map<unsigned int, GLuint> vbos;
-    std::unordered_map<unsigned int, GLuint> ibos;
-    std::unordered_map<unsigned int, GLuint> vaos;
+    std::unordered_map<std::string, MeshBuffers> mesh_buffers;
+
+    MeshBuffers& addMesh(const Mesh& mesh);
 
-    void addMesh(const Entity& entity);
+    void releaseMesh(MeshBuffers& buffers);
+
+    void initVAO(const MeshBuffers& buffers) const;
+
+    void bindInstanceAttributes(GLintptr offset) const;
 
     void prepareDraw() const;
 
-    void activateMesh(const Entity& mesh_entity);
+    void activateShader() const;
 
-    void activateShader(const Entity& entity);
+    void drawMesh(MeshBuffers& buffers);
 
-    void drawMesh(const Entity& entity);
+    CullStats cull_stats;
 
   public:
     void createFrame();
     void init();
 
     /**
-     * Draw all renderable sprites onto the screen.
+     * Draw all meshes onto the screen.
      */
     void draw();
 
     void updateShaders();
 
+    [[nodiscard]] const CullStats& getCullStats() const { return cull_stats; }
+
     ~MeshStage();
-};
\ No newline at end of file
+};
@@ -3,25 +3,15 @@
 #include "registry.hpp"
 #include "render.hpp"
 #include <glm/gtc/type_ptr.hpp>
-#include <optional>
 
 void ParticleStage::createBuffers() {
     glGenBuffers(1, &quad_vbo);
     glBindBuffer(GL_ARRAY_BUFFER, quad_vbo);
     glBufferData(GL_ARRAY_BUFFER, sizeof(textured_vertices), textured_vertices, GL_STATIC_DRAW);
 
-    glGenBuffers(1, &instance_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
-    allocateInstanceBuffer();
-
     checkGlErrors();
 }
 
-void ParticleStage::allocateInstanceBuffer() const {
-    const GLsizeiptr instance_buffer_size_bytes = sizeof(ParticleGPUData) * instance_buffer_size;
-    glBufferData(GL_ARRAY_BUFFER, instance_buffer_size_bytes, nullptr, GL_STREAM_DRAW);
-}
-
 void ParticleStage::initVAO() {
     glBindVertexArray(vao);
 
@@ -33,25 +23,26 @@ void ParticleStage::initVAO() {
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
     glEnableVertexAttribArray(1);
 
-    glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
-
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(ParticleGPUData), (void*)0);
-    glEnableVertexAttribArray(2);
-    checkGlErrors();
-    glVertexAttribDivisor(2, 1);
+    // the instance attributes are pointed at the streaming buffer for every draw, see `bindInstanceAttributes`
+    for (GLuint location = 2; location <= 6; location++) {
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
     checkGlErrors();
+}
 
-    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(ParticleGPUData), (void*)offsetof(ParticleGPUData, scale));
-    glEnableVertexAttribArray(3);
-    glVertexAttribDivisor(3, 1);
-
-    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(ParticleGPUData), (void*)offsetof(ParticleGPUData, color));
-    glEnableVertexAttribArray(4);
-    glVertexAttribDivisor(4, 1);
-
-    glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, sizeof(ParticleGPUData), (void*)offsetof(ParticleGPUData, angle));
-    glEnableVertexAttribArray(5);
-    glVertexAttribDivisor(5, 1);
+void ParticleStage::bindInstanceAttributes(const GLintptr offset) {
+    const auto attribute = [offset](const size_t member_offset) { return (void*)(offset + member_offset); };
+
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(ParticleGPUData), attribute(0));
+    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(ParticleGPUData),
+                          attribute(offsetof(ParticleGPUData, scale)));
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(ParticleGPUData),
+                          attribute(offsetof(ParticleGPUData, color)));
+    glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, sizeof(ParticleGPUData),
+                          attribute(offsetof(ParticleGPUData, angle)));
+    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(ParticleGPUData),
+                          attribute(offsetof(ParticleGPUData, uv_rect)));
 }
 
 void ParticleStage::init() {
@@ -96,47 +87,56 @@ void ParticleStage::draw() {
 
     glBindVertexArray(vao);
 
-    std::vector<std::optional<std::vector<ParticleGPUData>>> particle_groups;
+    for (auto& group : particle_groups) {
+        group.clear();
+    }
 
     const auto width = static_cast<float>(native_width);
     const auto height = static_cast<float>(native_height);
-    for (const Particle& particle : registry.particles.components) {
-        const auto pos = particle.position;
-        const auto scale = particle.scale;
-        // bounds check
-        if (pos.x - scale.x > width || pos.x + scale.x < 0.0 || pos.y - scale.y > height || pos.y + scale.y < 0.0)
-            continue;
+    cull_stats = {};
+    const auto add_instance = [&](const VirtualTextureHandle texture, const vec2 pos, const vec2 scale,
+                                  const vec4& color, const float angle) {
+        // bounds check, particles are anchored at a corner rather than centered like sprites, see `isOnScreen`
+        if (pos.x - scale.x > width || pos.x + scale.x < 0.0 || pos.y - scale.y > height || pos.y + scale.y < 0.0) {
+            cull_stats.culled++;
+            return;
+        }
+        cull_stats.drawn++;
 
-        ParticleGPUData p = {pos, scale, particle.color, particle.angle};
+        ParticleGPUData p = {pos, scale, color, texture_manager.getRegion(texture).uv_rect, angle};
 
-        if (particle.texture >= particle_groups.size()) {
-            particle_groups.resize(particle.texture + 1);
+        if (texture >= particle_groups.size()) {
+            particle_groups.resize(texture + 1);
         }
+        particle_groups[texture].emplace_back(p);
+    };
 
-        if (particle_groups[particle.texture].has_value()) {
-            particle_groups[particle.texture].value().emplace_back(p);
-        } else {
-            auto new_vec = std::vector<ParticleGPUData>();
-            new_vec.emplace_back(p);
-            particle_groups[particle.texture] = new_vec;
-        }
+    for (const Particle& particle : registry.particles.components) {
+        add_instance(particle.texture, particle.position, particle.scale, particle.color, particle.angle);
     }
 
-    glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
+    // trail points shrink around their center and fade out with age, the same way their particles used to
+    for (const LightTrail& trail : registry.lightTrails.components) {
+        for (int i = 0; i < LightTrail::POINT_COUNT; i++) {
+            const float age = trail.ages[i];
+            if (age >= LightTrail::LIFETIME) continue;
+
+            const float scale = LightTrail::INITIAL_SCALE + LightTrail::SCALE_CHANGE * age;
+            if (scale <= 0.0f) continue;
+            const vec2 position = trail.positions[i] - vec2(LightTrail::SCALE_CHANGE * age / 2.0f);
+            const vec4 color = vec4(vec3(trail.color), trail.color.a + LightTrail::ALPHA_CHANGE * age);
+            add_instance(trail.texture, position, vec2(scale), color, 0.0f);
+        }
+    }
 
     for (VirtualTextureHandle i = 0; i < particle_groups.size(); i++) {
-        const auto& opt = particle_groups[i];
-        if (!opt.has_value()) continue;
-        const auto& group = opt.value();
+        const auto& group = particle_groups[i];
+        if (group.empty()) continue;
 
-        if (group.size() > instance_buffer_size) {
-            instance_buffer_size = group.size() * 1.5;
-            allocateInstanceBuffer();
-        }
+        bindInstanceAttributes(streaming_buffer.push(group));
 
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, texture_manager.get(i));
-        glBufferSubData(GL_ARRAY_BUFFER, 0, group.size() * sizeof(ParticleGPUData), group.data());
         glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, group.size());
     }
 }
@@ -14,6 +14,7 @@ struct ParticleGPUData {
     vec2 position;
     vec2 scale;
     vec4 color;
+    vec4 uv_rect;
     float angle;
     float _padding[3] = {0, 0, 0};
 };
@@ -25,10 +26,10 @@ struct ParticleGPUData {
  * This stage uses an instanced renderer and batches draw calls
  * by particle groups (basically particles that all use the same texture).
  *
- * This stage has two buffers. One is a buffer that stores information for a generic
- * textured quad, which is static across all instances. The other buffer stores information
- * specific to each instance, such as position, scale, angle, and color. This buffer
- * can be updated every frame as particle information changes. The transform
+ * This stage uses two buffers. One is a buffer that stores information for a generic
+ * textured quad, which is static across all instances. The information specific to each instance,
+ * such as position, scale, angle, and color, changes every frame and is written into the
+ * shared `streaming_buffer`. The transform
  * matrix is constructed in the vertex shader and applied to the generic quad's object coordinates.
  * The renderer then groups the particles by their texture, and does one instanced draw call for every group.
  *
@@ -44,10 +45,12 @@ class ParticleStage {
     ShaderHandle shader = 0;
 
     GLuint quad_vbo = 0;
-    GLuint instance_vbo = 0;
     GLuint vao = 0;
 
-    GLsizei instance_buffer_size = 100;
+    /**
+     * Instances of this frame, indexed by their texture. Kept around so their memory is reused across frames.
+     */
+    std::vector<std::vector<ParticleGPUData>> particle_groups;
 
     mat3 projection_matrix = createProjectionMatrix();
 
@@ -59,12 +62,17 @@ class ParticleStage {
 
     void createBuffers();
 
-    void allocateInstanceBuffer() const;
-
     void initVAO();
 
+    /**
+     * Point the instance attributes of the bound VAO at instances pushed into the streaming buffer.
+     */
+    static void bindInstanceAttributes(GLintptr offset);
+
     void prepareDraw() const;
 
+    CullStats cull_stats;
+
   public:
     void init();
 
@@ -72,5 +80,7 @@ class ParticleStage {
 
     void updateShaders();
 
+    [[nodiscard]] const CullStats& getCullStats() const { return cull_stats; }
+
     ~ParticleStage();
 };
@@ -1,3 +1,4 @@
+#include "allocations.hpp"
 #include "registry.hpp"
 #include "render.hpp"
 #include "sprite.hpp"
@@ -28,6 +29,16 @@ void SpriteStage::init() {
     const GLenum draw_buffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
     glDrawBuffers(2, draw_buffers);
 
+    // static sprites are all in the world, they don't need a ui texture
+    glGenFramebuffers(1, &static_frame_buffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, static_frame_buffer);
+    glGenTextures(1, &static_texture);
+    glBindTexture(GL_TEXTURE_2D, static_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, native_width, native_height, 0, GL_RGBA, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, static_texture, 0);
+
     // go back to the default framebuffer
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
@@ -77,12 +88,20 @@ void SpriteStage::activateShader(const Entity& entity, const Motion& motion, con
     setUniformFloat(shader, "horizontal_offset", material.texture.h_offset);
     setUniformFloat(shader, "vertical_offset", material.texture.v_offset);
     setUniformFloatVec2(shader, "cell_size", material.texture.cell_size);
-
-    // Enabling and binding texture to slot 0 and 1
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, material.texture.albedo);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, material.texture.normal);
+    setUniformFloatVec4(shader, "uv_rect", material.texture.uv_rect);
+
+    // Enabling and binding texture to slot 0 and 1. Most sprites live in the texture atlas, so the textures
+    // usually are already bound from the previous sprite
+    if (material.texture.albedo != bound_albedo) {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, material.texture.albedo);
+        bound_albedo = material.texture.albedo;
+    }
+    if (material.texture.normal != bound_normal) {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, material.texture.normal);
+        bound_normal = material.texture.normal;
+    }
 
     const bool isHighlighted = registry.highlightables.has(entity) && registry.highlightables.get(entity).isHighlighted;
     setUniformInt(shader, "highlight", isHighlighted ? 1 : 0);
@@ -91,16 +110,15 @@ void SpriteStage::activateShader(const Entity& entity, const Motion& motion, con
 }
 
 /**
- * Prepare for drawing by setting various OpenGL flags, setting and clearing the framebuffer,
- * and updating the viewport.
+ * Prepare for drawing by setting various OpenGL flags and updating the viewport.
  */
 void SpriteStage::prepareDraw() const {
-    glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer);
-
     glUseProgram(shader);
 
     setUniformInt(shader, "albedo_tex", 0);
     setUniformInt(shader, "normal_tex", 1);
+    bound_albedo = 0;
+    bound_normal = 0;
 
     if (registry.ambientLights.size() == 0) {
         LOG_WARN("No ambient light found, using default ambient light.");
@@ -134,7 +152,6 @@ void SpriteStage::prepareDraw() const {
     // glDepthRange(0.0, 1.0);
     glClearColor(static_cast<GLfloat>(0.0), static_cast<GLfloat>(0.0), static_cast<GLfloat>(0.0), 0.0);
     // glClearDepth(1.f);
-    glClear(GL_COLOR_BUFFER_BIT);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glDisable(GL_DEPTH_TEST);
@@ -171,22 +188,138 @@ void SpriteStage::drawSprite(const Entity& entity, const Material& material) con
     checkGlErrors();
 }
 
-void SpriteStage::draw() const {
-    prepareDraw();
+uint64_t SpriteStage::spriteHash(const Entity& entity, const Material& material) {
+    uint64_t hash = hashMaterial(material, hashMotion(registry.motions.get(entity), raycast::hash::FNV_OFFSET_BASIS));
+    const bool is_highlighted = registry.highlightables.has(entity) && registry.highlightables.get(entity).isHighlighted;
+    return raycast::hash::fnv1aValue(is_highlighted, hash);
+}
 
-    registry.materials.sort([](const Entity& e1, const Entity& e2) {
-        auto& m1 = registry.materials.get(e1);
-        auto& m2 = registry.materials.get(e2);
-        return m1.layer < m2.layer;
-    });
+uint64_t SpriteStage::lightingHash() {
+    uint64_t hash = raycast::hash::FNV_OFFSET_BASIS;
+    for (const AmbientLight& ambient_light : registry.ambientLights.components) {
+        hash = raycast::hash::fnv1aValue(ambient_light.color, hash);
+    }
+    for (size_t i = 0; i < registry.pointLights.size(); i++) {
+        const PointLight& point_light = registry.pointLights.components[i];
+        hash = raycast::hash::fnv1aValue(registry.motions.get(registry.pointLights.entities[i]).position, hash);
+        hash = raycast::hash::fnv1aValue(point_light.diffuse, hash);
+        hash = raycast::hash::fnv1aValue(point_light.constant, hash);
+        hash = raycast::hash::fnv1aValue(point_light.linear, hash);
+        hash = raycast::hash::fnv1aValue(point_light.quadratic, hash);
+    }
+    return hash;
+}
 
-    for (int i = 0; i < registry.materials.size(); i++) {
+uint64_t SpriteStage::classifySprites() {
+    frame_count++;
+    static_sprites.clear();
+    dynamic_sprites.clear();
+    cull_stats = {};
+
+    // the static texture sits below all other sprites, so a sprite can only be static if every sprite in the layers
+    // below it is static as well. Within a layer the draw order is arbitrary, static sprites just go first.
+    uint64_t static_hash_sum = 0;
+    bool below_is_static = true;
+    int current_layer = BACKGROUND;
+    bool layer_is_static = true;
+
+    for (size_t i = 0; i < registry.materials.size(); i++) {
         const Entity& entity = registry.materials.entities[i];
-        const auto& material = registry.materials.components[i];
-        if (!registry.invisibles.has(entity)) {
-            drawSprite(entity, material);
+        const Material& material = registry.materials.components[i];
+        if (registry.invisibles.has(entity)) {
+            continue;
+        }
+        if (!isOnScreen(registry.motions.get(entity))) {
+            cull_stats.culled++;
+            continue;
         }
+
+        if (material.layer != current_layer) {
+            below_is_static &= layer_is_static;
+            current_layer = material.layer;
+            layer_is_static = true;
+        }
+
+        // only the world layers below particles can be cached
+        if (material.layer > FOREGROUND) {
+            dynamic_sprites.push_back(i);
+            continue;
+        }
+
+        const uint64_t hash = spriteHash(entity, material);
+        SpriteHistory& history = sprite_history[entity];
+        history.unchanged_frames = history.hash == hash ? history.unchanged_frames + 1 : 0;
+        history.hash = hash;
+        history.last_seen_frame = frame_count;
+
+        if (below_is_static && history.unchanged_frames >= STATIC_AFTER_FRAMES) {
+            static_sprites.push_back(i);
+            static_hash_sum += raycast::hash::fnv1aValue(static_cast<unsigned int>(entity), hash);
+        } else {
+            dynamic_sprites.push_back(i);
+            layer_is_static = false;
+        }
+    }
+
+    cull_stats.drawn = static_sprites.size() + dynamic_sprites.size();
+
+    // forget about removed sprites every now and then
+    if (frame_count % 600 == 0) {
+        for (auto it = sprite_history.begin(); it != sprite_history.end();) {
+            it = it->second.last_seen_frame == frame_count ? std::next(it) : sprite_history.erase(it);
+        }
+    }
+
+    return raycast::hash::fnv1aValue(static_hash_sum, raycast::hash::fnv1aValue(static_sprites.size(), lightingHash()));
+}
+
+void SpriteStage::draw() {
+#ifdef RAYCAST_COUNT_ALLOCATIONS
+    const size_t allocations_before = raycast::allocations::count();
+#endif
+    prepareDraw();
+
+    // materials only change layers when they are added or removed, so they are almost always sorted already
+    registry.materials.sort_incremental([](const Material& m1, const Material& m2) { return m1.layer < m2.layer; });
+
+    const uint64_t fingerprint = classifySprites();
+    if (fingerprint != static_fingerprint) {
+        static_fingerprint = fingerprint;
+        glBindFramebuffer(GL_FRAMEBUFFER, static_frame_buffer);
+        glClear(GL_COLOR_BUFFER_BIT);
+        for (const size_t i : static_sprites) {
+            drawSprite(registry.materials.entities[i], registry.materials.components[i]);
+        }
+        LOG_DEBUG("Rendered {} static sprites, {} sprites are drawn every frame", static_sprites.size(),
+                  dynamic_sprites.size());
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    if (!static_sprites.empty()) {
+        // copy the static sprites into the world texture, the ui texture stays cleared
+        const GLenum world_only = GL_COLOR_ATTACHMENT0;
+        glDrawBuffers(1, &world_only);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, static_frame_buffer);
+        glBlitFramebuffer(0, 0, native_width, native_height, 0, 0, native_width, native_height, GL_COLOR_BUFFER_BIT,
+                          GL_NEAREST);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, frame_buffer);
+
+        const GLenum draw_buffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        glDrawBuffers(2, draw_buffers);
+    }
+
+    for (const size_t i : dynamic_sprites) {
+        drawSprite(registry.materials.entities[i], registry.materials.components[i]);
+    }
+
+#ifdef RAYCAST_COUNT_ALLOCATIONS
+    // new sprites get an entry in the sprite history, anything else is unexpected
+    if (const size_t allocations = raycast::allocations::count() - allocations_before; allocations > 0) {
+        LOG_DEBUG("Sprite stage made {} heap allocations this frame", allocations);
     }
+#endif
 }
 
 void SpriteStage::updateShaders() {
@@ -198,8 +331,10 @@ SpriteStage::~SpriteStage() {
     glDeleteBuffers(1, &ibo);
 
     glDeleteTextures(1, &world_texture);
+    glDeleteTextures(1, &static_texture);
     glDeleteVertexArrays(1, &vao);
     glDeleteFramebuffers(1, &frame_buffer);
+    glDeleteFramebuffers(1, &static_frame_buffer);
 
     checkGlErrors();
 }
@@ -4,10 +4,28 @@
 #include "shader.hpp"
 #include "util.hpp"
 
+#include <unordered_map>
+
 /**
 * Render all sprites in the world excluding text.
+*
+* Sprites at the bottom of the world (the background and level geometry that doesn't move) are rendered into a
+* separate static texture once, and only copied into the world texture every frame. A sprite counts as static once it
+* hasn't changed for `STATIC_AFTER_FRAMES` frames; the static texture is rendered again whenever the set of static
+* sprites, any of them, or the lighting changes.
 */
 class SpriteStage {
+    /**
+     * What the stage remembers about a sprite between frames to tell whether it is static.
+     */
+    struct SpriteHistory {
+        uint64_t hash = 0;
+        int unchanged_frames = 0;
+        uint64_t last_seen_frame = 0;
+    };
+
+    static constexpr int STATIC_AFTER_FRAMES = 30;
+
     /**
      * Intermediate frame texture. All drawing for this stage will be output to this texture
      */
@@ -15,6 +33,19 @@ class SpriteStage {
     TextureHandle ui_texture = 0;
     GLuint frame_buffer = 0;
 
+    TextureHandle static_texture = 0;
+    GLuint static_frame_buffer = 0;
+
+    /** Fingerprint of the static sprites and lighting the static texture was rendered with */
+    uint64_t static_fingerprint = 0;
+
+    std::unordered_map<unsigned int, SpriteHistory> sprite_history;
+    uint64_t frame_count = 0;
+
+    /** Indices into the material container of the sprites drawn this frame */
+    std::vector<size_t> static_sprites;
+    std::vector<size_t> dynamic_sprites;
+
     ShaderHandle shader = 0;
 
     GLuint vbo = 0;
@@ -23,6 +54,12 @@ class SpriteStage {
 
     mat3 projection_matrix = createProjectionMatrix();
 
+    /**
+     * Textures bound during the current draw, used to skip redundant binds
+     */
+    mutable TextureHandle bound_albedo = 0;
+    mutable TextureHandle bound_normal = 0;
+
     /**
      * Vertex data for a textured quad. Each vertex contains position and UV coordinates
      */
@@ -41,19 +78,45 @@ class SpriteStage {
 
     void prepareDraw() const;
 
+    /**
+     * Split this frame's sprites into static and dynamic ones.
+     * @return the fingerprint of the static sprites
+     */
+    uint64_t classifySprites();
+
+    /**
+     * Hash everything about a sprite that affects how it is drawn.
+     */
+    static uint64_t spriteHash(const Entity& entity, const Material& material);
+
+    /**
+     * Hash the lights, which affect every sprite in the world.
+     */
+    static uint64_t lightingHash();
+
     void activateShader(const Entity& entity, const Motion& motion, const Material& material) const;
 
     void drawSprite(const Entity& entity, const Material& material) const;
 
+    CullStats cull_stats;
+
   public:
     void init();
 
     /**
      * Draw all renderable sprites onto the screen.
      */
-    void draw() const;
+    void draw();
 
     void updateShaders();
 
+    /**
+     * Render the static texture again on the next draw. Needed whenever texels or shaders change underneath sprites
+     * that are otherwise unchanged.
+     */
+    void invalidateStatic() { static_fingerprint = 0; }
+
+    [[nodiscard]] const CullStats& getCullStats() const { return cull_stats; }
+
     ~SpriteStage();
 };
\ No newline at end of file
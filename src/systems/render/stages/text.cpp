@@ -18,14 +18,10 @@ void TextStage::init() {
     initFont();
     initFrame();
 
+    // the glyph quads are streamed every frame, the attribute is pointed at them in `renderText`
     glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
     glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(quad_vertices), quad_vertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, nullptr);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
     updateShaders();
@@ -128,12 +124,14 @@ void TextStage::renderText(const Text& text, float x, float y) {
     setUniformFloatVec4(shader, "textColor", text.color / 255.0f);
     setUniformFloatMat4(shader, "projection", projection_matrix);
     setUniformInt(shader, "layer", text.layer);
+    // glyph quads are placed on the CPU
+    setUniformFloatMat4(shader, "transform", mat4(1.0f));
 
     glActiveTexture(GL_TEXTURE0);
     glBindVertexArray(vao);
     checkGlErrors();
 
-    auto characters = getCharacterSet(text.size);
+    const auto& characters = getCharacterSet(text.size);
 
     float start_pos_x = x;
     float start_pos_y = y;
@@ -168,7 +166,10 @@ void TextStage::renderText(const Text& text, float x, float y) {
         y = start_pos_y;
     }
 
-    // iterate through all characters
+    glyph_vertices.clear();
+    glyph_textures.clear();
+
+    // lay out all characters, then draw them from a single upload
     for (const unsigned char c : text.text) {
         const float scale = 1.0;
         auto [texture, size, bearing, advance] = characters[c];
@@ -189,25 +190,25 @@ void TextStage::renderText(const Text& text, float x, float y) {
         const float scale_x = static_cast<float>(size.x) * scale;
         const float scale_y = static_cast<float>(size.y) * scale;
 
-        auto transform = mat4(1.0f);
-        transform *= translate(mat4(1.0f), vec3(pos_x, pos_y, 0.0f));
-        transform *= glm::scale(mat4(1.0f), vec3(scale_x, scale_y, 0.0f));
-
-        setUniformFloatMat4(shader, "transform", transform);
-
-        // render glyph texture over quad
-        glBindTexture(GL_TEXTURE_2D, texture);
-
-        // update content of VBO memory
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-
-        // render quad
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        // one textured quad per glyph, in the same layout as the quads of the other stages
+        for (const auto& [corner_x, corner_y, u, v] : quad_vertices) {
+            glyph_vertices.emplace_back(pos_x + corner_x * scale_x, pos_y + corner_y * scale_y, u, v);
+        }
+        glyph_textures.push_back(texture);
 
         // now advance cursors for next glyph (note that advance is number of 1/64 pixels)
         x += static_cast<float>(advance >> 6) * scale; // bitshift by 6 to get value in pixels (2^6 = 64)
     }
 
+    const GLintptr offset = streaming_buffer.push(glyph_vertices);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, (void*)offset);
+
+    for (size_t i = 0; i < glyph_textures.size(); i++) {
+        // render glyph texture over quad
+        glBindTexture(GL_TEXTURE_2D, glyph_textures[i]);
+        glDrawArrays(GL_TRIANGLE_STRIP, static_cast<GLint>(i * 4), 4);
+    }
+
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
     glBindTexture(GL_TEXTURE_2D, 0);
@@ -215,6 +216,28 @@ void TextStage::renderText(const Text& text, float x, float y) {
     checkGlErrors();
 }
 
+bool TextStage::isOnScreen(const Text& text, const float x, const float y) {
+    const auto& characters = getCharacterSet(text.size);
+
+    float width = 0;
+    float line_width = 0;
+    int lines = 1;
+    for (const unsigned char c : text.text) {
+        if (c == '\n') {
+            lines++;
+            line_width = 0;
+            continue;
+        }
+        if (c >= characters.size()) continue;
+        line_width += static_cast<float>(characters[c].advance >> 6);
+        width = max(width, line_width);
+    }
+    const float height = static_cast<float>(lines * text.size);
+
+    return x + width >= 0.f && x - width <= static_cast<float>(frame_width) && y + height >= 0.f &&
+           y - height <= static_cast<float>(frame_height);
+}
+
 void TextStage::prepareDraw() {
     projection_matrix = ortho(0.0f, static_cast<float>(frame_width), 0.0f, static_cast<float>(frame_height));
 
@@ -232,18 +255,26 @@ void TextStage::draw() {
     const auto world_width = static_cast<float>(native_width);
     const auto world_height = static_cast<float>(native_height);
 
-    for (const Text& text : registry.texts.components) {
-        if (text.layer == UI_TEXT) continue;
+    cull_stats = {};
+    const auto draw_text = [&](const Text& text) {
         const float x = (text.position.x / world_width) * static_cast<float>(frame_width);
         const float y = (text.position.y / world_height) * static_cast<float>(frame_height);
+        if (!isOnScreen(text, x, y)) {
+            cull_stats.culled++;
+            return;
+        }
+        cull_stats.drawn++;
         renderText(text, x, y);
+    };
+
+    for (const Text& text : registry.texts.components) {
+        if (text.layer == UI_TEXT) continue;
+        draw_text(text);
     }
 
     for (const Text& text : registry.texts.components) {
         if (text.layer == WORLD_TEXT) continue;
-        const float x = (text.position.x / world_width) * static_cast<float>(frame_width);
-        const float y = (text.position.y / world_height) * static_cast<float>(frame_height);
-        renderText(text, x, y);
+        draw_text(text);
     }
 }
 
@@ -253,7 +284,6 @@ void TextStage::updateShaders() {
 
 
 TextStage::~TextStage() {
-    glDeleteBuffers(1, &vbo);
     glDeleteVertexArrays(1, &vao);
 
     // Destroy &Face FIRST and then &FreeType because face is a child reference of library.
@@ -2,6 +2,7 @@
 #include "../shader.hpp"
 #include "common.hpp"
 #include "components.hpp"
+#include "util.hpp"
 
 struct Character {
     unsigned int texture;
@@ -20,7 +21,13 @@ class TextStage {
     FT_Face face = nullptr;
 
     GLuint vao = 0;
-    GLuint vbo = 0;
+
+    /**
+     * Quads of the glyphs of the text being drawn, four vertices each with position and UV coordinates, and their
+     * textures. Kept around so their memory is reused.
+     */
+    std::vector<vec4> glyph_vertices;
+    std::vector<unsigned int> glyph_textures;
 
     GLuint frame_buffer = 0;
     TextureHandle world_text_texture = 0;
@@ -35,7 +42,7 @@ class TextStage {
 
     mat4 projection_matrix = {};
 
-    GLfloat quad_vertices[4][4] = {
+    const GLfloat quad_vertices[4][4] = {
         {0.0f, 1.0f, 0.0f, 0.0f},
         {0.0f, 0.0f, 0.0f, 1.0f},
         {1.0f, 1.0f, 1.0f, 0.0f},
@@ -58,6 +65,14 @@ class TextStage {
 
     void renderText(const Text& text, float x, float y);
 
+    /**
+     * Whether any part of the text could end up inside the frame when drawn at the given position. Centered text
+     * extends to either side of its position, so the check allows for both.
+     */
+    bool isOnScreen(const Text& text, float x, float y);
+
+    CullStats cull_stats;
+
 public:
     /**
      * Initialize the text rendering system.
@@ -70,5 +85,7 @@ public:
 
     void updateShaders();
 
+    [[nodiscard]] const CullStats& getCullStats() const { return cull_stats; }
+
     ~TextStage();
 };
\ No newline at end of file
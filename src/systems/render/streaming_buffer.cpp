@@ -0,0 +1,117 @@
+#include "streaming_buffer.hpp"
+#include "logging/log.hpp"
+
+#include <cstring>
+
+namespace {
+// how often to log how much data went through the buffer
+constexpr size_t STATS_LOG_INTERVAL_FRAMES = 5 * 60;
+
+// fences of a region are only waited for when it comes around again two frames later, so waiting at all is rare
+constexpr GLuint64 FENCE_TIMEOUT_NS = 1000 * 1000 * 1000;
+} // namespace
+
+StreamingBuffer::~StreamingBuffer() {
+#ifndef __EMSCRIPTEN__
+    for (GLsync fence : fences) {
+        if (fence != nullptr) {
+            glDeleteSync(fence);
+        }
+    }
+#endif
+    glDeleteBuffers(1, &buffer);
+}
+
+void StreamingBuffer::init(const size_t initial_region_size) {
+    glGenBuffers(1, &buffer);
+    allocate(initial_region_size);
+}
+
+void StreamingBuffer::allocate(const size_t size) {
+    region_size = (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    region_offset = 0;
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(region_size * FRAME_COUNT), nullptr, GL_STREAM_DRAW);
+
+#ifndef __EMSCRIPTEN__
+    // the new storage isn't used by anything yet
+    for (GLsync& fence : fences) {
+        if (fence != nullptr) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+#endif
+    checkGlErrors();
+}
+
+void StreamingBuffer::beginFrame() {
+    region_offset = 0;
+
+#ifdef __EMSCRIPTEN__
+    // hand the old storage to the driver and write into fresh storage, the regions are not needed
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(region_size * FRAME_COUNT), nullptr, GL_STREAM_DRAW);
+#else
+    region = (region + 1) % FRAME_COUNT;
+    GLsync& fence = fences[region];
+    if (fence != nullptr) {
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            stalls++;
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+#endif
+}
+
+void StreamingBuffer::endFrame() {
+#ifndef __EMSCRIPTEN__
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#endif
+
+    streamed_bytes += region_offset;
+    peak_frame_bytes = max(peak_frame_bytes, region_offset);
+    if (++frames >= STATS_LOG_INTERVAL_FRAMES) {
+        LOG_DEBUG("Streamed {:.1f} KiB per frame on average, {:.1f} KiB at most, waited for the GPU {} times",
+                  static_cast<float>(streamed_bytes) / static_cast<float>(frames) / 1024.f,
+                  static_cast<float>(peak_frame_bytes) / 1024.f, stalls);
+        frames = 0;
+        streamed_bytes = 0;
+        peak_frame_bytes = 0;
+        stalls = 0;
+    }
+}
+
+GLintptr StreamingBuffer::push(const void* data, const size_t size) {
+    if (region_offset + size > region_size) {
+        const size_t new_size = max(region_size * 2, region_offset + size);
+        LOG_DEBUG("Growing the streaming buffer from {} KiB to {} KiB per frame", region_size / 1024, new_size / 1024);
+        allocate(new_size);
+    }
+
+    const auto offset = static_cast<GLintptr>(region * region_size + region_offset);
+    region_offset = (region_offset + size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    if (size == 0) {
+        return offset;
+    }
+
+#ifdef __EMSCRIPTEN__
+    glBufferSubData(GL_ARRAY_BUFFER, offset, static_cast<GLsizeiptr>(size), data);
+#else
+    // nothing reads this part of the buffer, the fences made sure of that
+    void* mapped = glMapBufferRange(GL_ARRAY_BUFFER, offset, static_cast<GLsizeiptr>(size),
+                                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (mapped == nullptr) {
+        glBufferSubData(GL_ARRAY_BUFFER, offset, static_cast<GLsizeiptr>(size), data);
+    } else {
+        std::memcpy(mapped, data, size);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+#endif
+    return offset;
+}
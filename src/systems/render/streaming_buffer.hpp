@@ -0,0 +1,73 @@
+#pragma once
+#include "common.hpp"
+
+#include <array>
+#include <vector>
+
+/**
+ * One vertex buffer that all render stages stream their per-frame vertex and instance data through.
+ *
+ * The buffer is split into `FRAME_COUNT` regions, and every frame appends into the next region. On desktop, data is
+ * written with unsynchronized `glMapBufferRange`, so the driver never has to wait for or copy data the GPU is still
+ * reading. Instead a fence at the end of every frame tells when its region can be written again, which normally
+ * already happened by the time it comes around. WebGL can't map buffers, so there the buffer is orphaned at the start
+ * of every frame and written with `glBufferSubData`.
+ *
+ * When a frame needs more memory than a region has, the buffer grows, which costs one reallocation.
+ */
+class StreamingBuffer {
+    static constexpr int FRAME_COUNT = 3;
+
+    /** Offsets handed out by `push` are aligned to this, which satisfies any vertex attribute */
+    static constexpr size_t ALIGNMENT = 16;
+
+    GLuint buffer = 0;
+    size_t region_size = 0;
+    int region = 0;
+    size_t region_offset = 0;
+
+#ifndef __EMSCRIPTEN__
+    std::array<GLsync, FRAME_COUNT> fences = {};
+#endif
+
+    size_t frames = 0;
+    size_t streamed_bytes = 0;
+    size_t peak_frame_bytes = 0;
+    size_t stalls = 0;
+
+    /**
+     * (Re)allocate the buffer with regions of the given size. Data pushed earlier in the frame stays valid for the
+     * draws already issued, OpenGL keeps the old storage alive until they are done.
+     */
+    void allocate(size_t size);
+
+  public:
+    StreamingBuffer() = default;
+    StreamingBuffer(const StreamingBuffer&) = delete;
+    StreamingBuffer& operator=(const StreamingBuffer&) = delete;
+    ~StreamingBuffer();
+
+    /**
+     * @param initial_region_size Bytes available to each frame before the buffer has to grow
+     */
+    void init(size_t initial_region_size);
+
+    /**
+     * Move on to the next region, waiting for the GPU if it still reads from it. Call once at the start of a frame.
+     */
+    void beginFrame();
+
+    void endFrame();
+
+    /**
+     * Append data for this frame. Leaves the buffer bound to `GL_ARRAY_BUFFER`.
+     * @return the offset of the data in the buffer, to point vertex attributes at
+     */
+    GLintptr push(const void* data, size_t size);
+
+    template <typename T> GLintptr push(const std::vector<T>& data) {
+        return push(data.data(), data.size() * sizeof(T));
+    }
+
+    [[nodiscard]] GLuint handle() const { return buffer; }
+};
@@ -1,102 +1,490 @@
 #include "texture.hpp"
+#include "atlas.hpp"
+#include "utils/hash.hpp"
+#include "utils/time.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <set>
 #include <string>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
-void TextureManager::addFromPath(const std::filesystem::directory_entry& entry) {
-    const auto& path = entry.path();
-    const std::string texture_name = path.stem().string();
+std::unordered_map<std::string, TextureManager::TextureFile>
+TextureManager::listTextureFiles(const std::string& folder) {
+    std::unordered_map<std::string, TextureFile> files;
 
-    if (!path.has_extension())
-        return;
-    const std::string extension = path.extension().string();
-    if (extension[extension.size() - 1] == '~')
-        return;
+    for (const auto& entry : std::filesystem::directory_iterator(textures_path(folder))) {
+        const auto& path = entry.path();
+        const std::string texture_name = path.stem().string();
 
-    if (texture_name.rfind('$', 0) == 0) {
-        LOG_ERROR("Texture with name {} in the textures folder starts with reserved prefix character '$'. Please "
-                  "rename the texture to something else.",
-                  texture_name);
-        assert(false);
+        if (!path.has_extension())
+            continue;
+        const std::string extension = path.extension().string();
+        if (extension[extension.size() - 1] == '~')
+            continue;
+
+        if (texture_name.rfind('$', 0) == 0) {
+            LOG_ERROR("Texture with name {} in the textures folder starts with reserved prefix character '$'. Please "
+                      "rename the texture to something else.",
+                      texture_name);
+            assert(false);
+        }
+
+        TextureFile file = {texture_name, path};
+        if (stbi_info(path.string().c_str(), &file.size.x, &file.size.y, nullptr) == 0) {
+            LOG_WARN("Failed to read file {}", path.string());
+            continue;
+        }
+        files[texture_name] = file;
+    }
+
+    return files;
+}
+
+namespace {
+/**
+ * Header of a texture cache file. It is followed by `width * height` RGBA8 texels.
+ */
+struct CachedImageHeader {
+    char magic[4];
+    uint32_t version;
+    int64_t source_write_time;
+    uint64_t source_hash;
+    int32_t width;
+    int32_t height;
+};
+
+constexpr char CACHED_IMAGE_MAGIC[4] = {'R', 'T', 'E', 'X'};
+constexpr uint32_t CACHED_IMAGE_VERSION = 1;
+
+std::atomic<size_t> cache_hits = 0;
+std::atomic<size_t> cache_misses = 0;
+std::atomic<size_t> temporary_file_count = 0;
+} // namespace
+
+std::string TextureManager::cachedImagePath(const std::filesystem::path& path) {
+    // e.g. textures/albedo/light.png -> cache/textures/albedo/light.rtex
+    return cache_path("textures/" + path.parent_path().filename().string() + "/" + path.stem().string() + ".rtex");
+}
+
+bool TextureManager::loadCachedImage(const std::string& cached_path, const int64_t source_write_time,
+                                     const uint64_t source_hash, Image& out_image) {
+    auto file = std::make_shared<MappedFile>();
+    if (!file->open(cached_path) || file->size() < sizeof(CachedImageHeader)) {
+        return false;
+    }
+
+    CachedImageHeader header{};
+    std::memcpy(&header, file->data(), sizeof(header));
+    const size_t texels_size = static_cast<size_t>(header.width) * header.height * 4;
+
+    // write times of embedded files are set when the web build is packaged, so only the hash can be compared there
+#ifdef __EMSCRIPTEN__
+    const bool write_time_matches = true;
+#else
+    const bool write_time_matches = header.source_write_time == source_write_time;
+#endif
+
+    if (std::memcmp(header.magic, CACHED_IMAGE_MAGIC, sizeof(CACHED_IMAGE_MAGIC)) != 0 ||
+        header.version != CACHED_IMAGE_VERSION || !write_time_matches || header.source_hash != source_hash ||
+        file->size() != sizeof(header) + texels_size) {
+        return false;
+    }
+
+    out_image.size = {header.width, header.height};
+    out_image.pixels.clear();
+    out_image.mapped = std::move(file);
+    out_image.mapped_offset = sizeof(header);
+    return true;
+}
+
+void TextureManager::writeCachedImage(const std::string& cached_path, const int64_t source_write_time,
+                                      const uint64_t source_hash, const Image& image) {
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(cached_path).parent_path(), error);
+
+    // write to a temporary file first, so a crash never leaves a truncated cache file behind. Every writer gets a
+    // file of its own, workers may write the same image at the same time
+    const std::string temporary_path = cached_path + "." + std::to_string(temporary_file_count++) + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return;
+        }
+
+        CachedImageHeader header{};
+        std::memcpy(header.magic, CACHED_IMAGE_MAGIC, sizeof(CACHED_IMAGE_MAGIC));
+        header.version = CACHED_IMAGE_VERSION;
+        header.source_write_time = source_write_time;
+        header.source_hash = source_hash;
+        header.width = image.size.x;
+        header.height = image.size.y;
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(image.data()), static_cast<std::streamsize>(image.byteSize()));
+        if (!file.good()) {
+            file.close();
+            std::filesystem::remove(temporary_path, error);
+            return;
+        }
+    }
+    std::filesystem::rename(temporary_path, cached_path, error);
+    if (error) {
+        LOG_WARN("Failed to write texture cache file '{}': {}", cached_path, error.message());
+        std::filesystem::remove(temporary_path, error);
+    }
+}
+
+bool TextureManager::decodeImage(const std::filesystem::path& path, Image& out_image) {
+    MappedFile source;
+    if (!source.open(path.string())) {
+        LOG_WARN("Failed to read file {}", path.string());
+        return false;
+    }
+
+    std::error_code error;
+    const auto write_time = std::filesystem::last_write_time(path, error);
+    const int64_t source_write_time = error ? 0 : static_cast<int64_t>(write_time.time_since_epoch().count());
+    const uint64_t source_hash = raycast::hash::fnv1a(source.data(), source.size());
+
+    const std::string cached_path = cachedImagePath(path);
+    if (loadCachedImage(cached_path, source_write_time, source_hash, out_image)) {
+        cache_hits++;
+        return true;
     }
 
-    ivec2 dimensions;
-    stbi_uc* data = stbi_load(path.string().c_str(), &dimensions.x, &dimensions.y, nullptr, 4);
+    stbi_uc* data = stbi_load_from_memory(source.data(), static_cast<int>(source.size()), &out_image.size.x,
+                                          &out_image.size.y, nullptr, 4);
     if (data == nullptr) {
         LOG_WARN("Failed to read file {}", path.string());
-        return;
+        return false;
+    }
+
+    out_image.pixels.assign(data, data + out_image.byteSize());
+    out_image.mapped = nullptr;
+    stbi_image_free(data);
+
+    cache_misses++;
+    writeCachedImage(cached_path, source_write_time, source_hash, out_image);
+    return true;
+}
+
+/**
+ * Nearest-neighbour resize, used to fit normal maps to the size of their albedo texture in the atlas.
+ */
+TextureManager::Image TextureManager::resizeImage(const Image& image, const ivec2 size) {
+    if (image.size == size) {
+        return image;
     }
 
-    GLuint texture;
-    glGenTextures(1, &texture);
+    Image resized;
+    resized.size = size;
+    resized.pixels.resize(static_cast<size_t>(size.x) * size.y * 4);
+    for (int y = 0; y < size.y; y++) {
+        const int source_y = y * image.size.y / size.y;
+        for (int x = 0; x < size.x; x++) {
+            const int source_x = x * image.size.x / size.x;
+            std::memcpy(&resized.pixels[(static_cast<size_t>(y) * size.x + x) * 4],
+                        &image.data()[(static_cast<size_t>(source_y) * image.size.x + source_x) * 4], 4);
+        }
+    }
+    return resized;
+}
+
+TextureHandle TextureManager::createTexture(const ivec2 size, const uint8_t* pixels, TextureHandle texture) {
+    if (texture == 0) {
+        glGenTextures(1, &texture);
+    }
     glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, dimensions.x, dimensions.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     checkGlErrors();
-    stbi_image_free(data);
+    return texture;
+}
+
+TextureManager::DecodedTexture TextureManager::decodeTexture(const TextureFile& file,
+                                                             const std::filesystem::path& normal_path,
+                                                             const Image* decoded_normal) {
+    DecodedTexture texture;
+    texture.file = file;
+    if (!decodeImage(file.path, texture.albedo)) {
+        return texture;
+    }
+
+    bool has_normal = false;
+    if (decoded_normal != nullptr) {
+        texture.normal = *decoded_normal;
+        has_normal = true;
+    } else if (!normal_path.empty()) {
+        has_normal = decodeImage(normal_path, texture.normal);
+    }
+    if (has_normal && file.in_atlas) {
+        // normal maps share the layout of the albedo atlas, so they need to cover the same rect
+        texture.normal = resizeImage(texture.normal, texture.albedo.size);
+    }
+    return texture;
+}
+
+std::filesystem::path TextureManager::normalPath(const TextureFile& file) const {
+    const auto it = normal_files.find(file.name + "_n");
+    if (it != normal_files.end()) {
+        return it->second.path;
+    }
+    // the atlas needs a flat normal map in place of missing ones, standalone textures just use `default_n`
+    return file.in_atlas ? normal_files.at("default_n").path : std::filesystem::path();
+}
+
+void TextureManager::setRegion(const std::string& name, const TextureRegion& region) {
+    regions[name] = region;
+
+    auto it = name_to_virtual.find(name);
+    if (it == name_to_virtual.end()) {
+        it = name_to_virtual.emplace(name, virtual_regions.size()).first;
+        virtual_regions.emplace_back();
+    }
+    virtual_regions[it->second] = region;
+}
+
+void TextureManager::uploadPixels(const TextureHandle texture, const ivec2 position, const Image& image,
+                                  const bool whole_texture) {
+    if (image.byteSize() == 0) {
+        return;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    if (whole_texture) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.size.x, image.size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                     image.data());
+    } else {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, position.x, position.y, image.size.x, image.size.y, GL_RGBA,
+                        GL_UNSIGNED_BYTE, image.data());
+    }
+    checkGlErrors();
+}
+
+void TextureManager::uploadTexture(const DecodedTexture& texture) {
+    const TextureFile& file = texture.file;
+
+    if (!file.in_atlas) {
+        uploadPixels(textures.at(file.name), {0, 0}, texture.albedo, true);
+        const auto normal = textures.find(file.name + "_n");
+        if (normal != textures.end()) {
+            uploadPixels(normal->second, {0, 0}, texture.normal, true);
+        }
+        return;
+    }
 
-    if (textures.find(texture_name) != textures.end()) {
-        LOG_INFO("Updating texture '{}'", texture_name);
-        glDeleteTextures(1, &textures[texture_name]);
+    uploadPixels(albedo_atlas, file.atlas_position, texture.albedo, false);
+    uploadPixels(normal_atlas, file.atlas_position, texture.normal, false);
+}
+
+void TextureManager::loadTextures() {
+    albedo_files = listTextureFiles("albedo");
+    normal_files = listTextureFiles("normal");
+
+    // the flat default normal map is needed for standalone textures that don't have a normal map of their own
+    const auto default_normal = std::make_shared<Image>();
+    decodeImage(normal_files.at("default_n").path, *default_normal);
+    textures["default_n"] = createTexture(default_normal->size, default_normal->data());
+
+    GLint max_texture_size = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+
+    // pack from tallest to shortest, the skyline heuristic works best that way
+    std::vector<TextureFile*> packing_order;
+    for (auto& [name, file] : albedo_files) {
+        packing_order.push_back(&file);
+    }
+    std::sort(packing_order.begin(), packing_order.end(), [](const TextureFile* a, const TextureFile* b) {
+        return a->size.y != b->size.y ? a->size.y > b->size.y : a->name < b->name;
+    });
+
+    SkylinePacker packer(std::min(ATLAS_WIDTH, max_texture_size), max_texture_size);
+    for (TextureFile* file : packing_order) {
+        ivec2 position;
+        if (packer.pack(file->size + 2 * ATLAS_PADDING, position)) {
+            file->in_atlas = true;
+            file->atlas_position = position + ATLAS_PADDING;
+        } else {
+            LOG_WARN("Texture '{}' ({}x{}) does not fit in the texture atlas, it will be kept as a separate texture",
+                     file->name, file->size.x, file->size.y);
+        }
+    }
+
+    // the atlas starts out fully transparent, which doubles as the placeholder for textures that are still loading
+    atlas_size = packer.size();
+    const std::vector<uint8_t> empty(static_cast<size_t>(atlas_size.x) * atlas_size.y * 4, 0);
+    albedo_atlas = createTexture(atlas_size, empty.data(), albedo_atlas);
+    normal_atlas = createTexture(atlas_size, empty.data(), normal_atlas);
+    LOG_INFO("Packed {} textures into a {}x{} atlas", albedo_files.size(), atlas_size.x, atlas_size.y);
+
+    const vec2 atlas_dimensions = atlas_size;
+    for (const auto& [name, file] : albedo_files) {
+        if (file.in_atlas) {
+            const vec4 uv_rect = {vec2(file.atlas_position) / atlas_dimensions, vec2(file.size) / atlas_dimensions};
+            setRegion(name, {albedo_atlas, normal_atlas, uv_rect});
+        } else {
+            // standalone textures get a transparent 1x1 placeholder, replaced in place once they are decoded
+            textures[name] = createTexture({1, 1}, empty.data());
+            TextureHandle normal = textures.at("default_n");
+            if (normal_files.find(name + "_n") != normal_files.end()) {
+                normal = textures[name + "_n"] = createTexture({1, 1}, empty.data());
+            }
+            setRegion(name, {textures[name], normal});
+        }
+    }
+
+    pending_uploads += albedo_files.size();
+    for (const auto& [name, file] : albedo_files) {
+        // the default normal map fills in for most textures, it is decoded once above instead of once per texture
+        const std::filesystem::path normal_path = normalPath(file);
+        std::shared_ptr<const Image> decoded_normal;
+        if (normal_path == normal_files.at("default_n").path) {
+            decoded_normal = default_normal;
+        }
+        decoder->submit([this, file = file, normal_path, decoded_normal] {
+            DecodedTexture texture = decodeTexture(file, normal_path, decoded_normal.get());
+            std::lock_guard<std::mutex> lock(decoded_mutex);
+            decoded.push_back(std::move(texture));
+        });
     }
+}
+
+void TextureManager::releaseTextures() {
+    // the atlas textures are kept and resized when they are repacked, so textures that keep their place in the
+    // atlas don't need to be resolved again
 
-    texture_count++;
-    write_times[texture_name] = entry.last_write_time();
-    textures[texture_name] = texture;
-    name_to_virtual[texture_name] = texture_count;
-    virtual_to_actual[texture_count] = texture;
+    // internal textures are owned by whoever added them
+    for (auto it = textures.begin(); it != textures.end();) {
+        if (it->first.rfind('$', 0) == 0) {
+            ++it;
+            continue;
+        }
+        glDeleteTextures(1, &it->second);
+        it = textures.erase(it);
+    }
+    checkGlErrors();
 }
 
 void TextureManager::init() {
     if (initialized)
         return;
 
-    const auto albedo_folder = std::filesystem::directory_entry(textures_path("albedo"));
-    last_albedo_write_time = albedo_folder.last_write_time();
-    const auto normal_folder = std::filesystem::directory_entry(textures_path("normal"));
-    last_normal_write_time = normal_folder.last_write_time();
+    decoder = std::make_unique<ThreadPool>();
+
+    loadTextures();
+
+    initialized = true;
+}
+
+bool TextureManager::pump() {
+    if (pending_uploads == 0) {
+        return false;
+    }
 
-    for (const auto& entry : std::filesystem::directory_iterator(textures_path("albedo"))) {
-        addFromPath(entry);
+    std::vector<DecodedTexture> ready;
+    {
+        std::lock_guard<std::mutex> lock(decoded_mutex);
+        ready.swap(decoded);
     }
 
-    for (const auto& entry : std::filesystem::directory_iterator(textures_path("normal"))) {
-        addFromPath(entry);
+    for (const DecodedTexture& texture : ready) {
+        uploadTexture(texture);
     }
 
-    initialized = true;
+    pending_uploads -= ready.size();
+    if (!ready.empty() && pending_uploads == 0) {
+        LOG_INFO("Finished loading textures {:.1f} ms after startup ({} images read from the texture cache, {} decoded)",
+                 raycast::time::ms_since(raycast::time::process_start), cache_hits.load(), cache_misses.load());
+    }
+    return !ready.empty();
 }
 
-bool TextureManager::update() {
-    bool textures_updated = false;
-    const auto albedo_folder = std::filesystem::directory_entry(textures_path("albedo"));
-    if (last_albedo_write_time != albedo_folder.last_write_time()) {
-        last_albedo_write_time = albedo_folder.last_write_time();
-        textures_updated = true;
-        for (const auto& entry : std::filesystem::directory_iterator(textures_path("albedo"))) {
-            const std::string texture_name = entry.path().stem().string();
-            if ((write_times.find(texture_name) == write_times.end()) ||
-                entry.last_write_time() > write_times[texture_name]) {
-                addFromPath(entry);
+std::set<std::string> TextureManager::update(const std::vector<std::filesystem::path>& changed_files) {
+    std::set<std::string> moved;
+    if (loading()) {
+        LOG_WARN("Textures changed while the previous textures are still loading, ignoring the change");
+        return moved;
+    }
+
+    bool layout_changed = false;
+    std::set<const TextureFile*> changed;
+    for (const auto& path : changed_files) {
+        TextureFileChange change;
+        if (!textureFileChange(path, change))
+            continue;
+
+        // textures that were deleted are left in place, they may still be in use
+        ivec2 size;
+        if (stbi_info(path.string().c_str(), &size.x, &size.y, nullptr) == 0)
+            continue;
+
+        const std::string& texture_name = change.name;
+        if (!change.is_normal) {
+            const auto file = albedo_files.find(texture_name);
+            if (file == albedo_files.end()) {
+                layout_changed = true;
+            } else {
+                layout_changed |= file->second.in_atlas && size != file->second.size;
+                changed.insert(&file->second);
+            }
+            continue;
+        }
+
+        // normal maps are uploaded together with their albedo texture, new ones need a texture or atlas rect of
+        // their own, and the default one fills in for every texture without a normal map
+        const std::string albedo_name = texture_name.substr(0, texture_name.size() - 2);
+        const auto file = albedo_files.find(albedo_name);
+        if (texture_name == "default_n" || normal_files.find(texture_name) == normal_files.end()) {
+            layout_changed = true;
+        } else if (file != albedo_files.end()) {
+            changed.insert(&file->second);
+        }
+    }
+
+    if (layout_changed) {
+        // a texture was added or resized, the atlas has to be packed again
+        LOG_INFO("Rebuilding texture atlas");
+        const auto previous_regions = regions;
+        releaseTextures();
+        loadTextures();
+
+        for (const auto& [name, region] : regions) {
+            const auto previous = previous_regions.find(name);
+            if (previous == previous_regions.end() || previous->second.albedo != region.albedo ||
+                previous->second.normal != region.normal || previous->second.uv_rect != region.uv_rect) {
+                moved.insert(name);
             }
         }
+        return moved;
     }
-    return textures_updated;
+
+    for (const TextureFile* file : changed) {
+        LOG_INFO("Updating texture '{}'", file->name);
+        uploadTexture(decodeTexture(*file, normalPath(*file)));
+    }
+    return moved;
 }
 
 TextureHandle TextureManager::get(const std::string& name) const {
-    if (textures.find(name) == textures.end()) {
+    return getRegion(name).albedo;
+}
+
+const TextureRegion& TextureManager::getRegion(const std::string& name) const {
+    if (regions.find(name) == regions.end()) {
         LOG_ERROR("The texture '{}' doesn't exist. Please check the spelling and make sure to leave out the file "
                   "extension.",
                   name)
         assert(false);
     }
-    return textures.at(name);
+    return regions.at(name);
 }
 
 VirtualTextureHandle TextureManager::getVirtual(const std::string& name) const {
@@ -108,27 +496,29 @@ VirtualTextureHandle TextureManager::getVirtual(const std::string& name) const {
 }
 
 TextureHandle TextureManager::get(VirtualTextureHandle virtual_handle) const {
-    if (virtual_to_actual.find(virtual_handle) == virtual_to_actual.end()) {
+    return getRegion(virtual_handle).albedo;
+}
+
+const TextureRegion& TextureManager::getRegion(VirtualTextureHandle virtual_handle) const {
+    if (virtual_handle == 0 || virtual_handle >= virtual_regions.size()) {
         LOG_ERROR("The virtual texture ID '{}'", virtual_handle)
-        return 0;
+        return virtual_regions[0];
     }
-    return virtual_to_actual.at(virtual_handle);
+    return virtual_regions[virtual_handle];
 }
 
 TextureHandle TextureManager::getNormal(const std::string& name) const {
-    const std::string normal_name = name + "_n";
-    if (textures.find(normal_name) == textures.end()) {
+    const auto it = regions.find(name);
+    if (it == regions.end()) {
         return textures.at("default_n");
     }
-    return textures.at(normal_name);
+    return it->second.normal;
 }
 
 void TextureManager::add(const std::string& name, const TextureHandle& texture) {
     if (textures.find(name) != textures.end()) {
         LOG_WARN("Texture with name '{}' already exists. Adding it again will overwrite the texture ID.", name);
     }
-    texture_count++;
     textures[name] = texture;
-    name_to_virtual[name] = texture_count;
-    virtual_to_actual[texture_count] = texture;
+    setRegion(name, {texture, texture});
 }
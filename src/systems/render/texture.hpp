@@ -1,6 +1,11 @@
 #pragma once
 #include "common.hpp"
+#include "mapped_file.hpp"
+#include "thread_pool.hpp"
 
+#include <memory>
+#include <mutex>
+#include <set>
 #include <unordered_map>
 
 #include <filesystem>
@@ -15,24 +20,189 @@ typedef GLuint TextureHandle;
  */
 typedef size_t VirtualTextureHandle;
 
+/**
+ * The textures holding the texels of a named texture, and the part of them it covers.
+ *
+ * Textures packed into the atlas share the atlas' albedo and normal textures and only cover `uv_rect` of them
+ * (offset in xy, size in zw, in normalized texture coordinates). Standalone textures cover their whole texture.
+ */
+struct TextureRegion {
+    TextureHandle albedo = 0;
+    TextureHandle normal = 0;
+    vec4 uv_rect = {0, 0, 1, 1};
+};
+
+/**
+ * The texture a changed file on disk belongs to.
+ */
+struct TextureFileChange {
+    std::string name;
+    bool is_normal = false;
+};
+
+/**
+ * Find out which texture a file reported by the file watcher belongs to. Files outside of the albedo and normal
+ * folders and editor backup files don't belong to any texture.
+ * @return whether the file belongs to a texture
+ */
+inline bool textureFileChange(const std::filesystem::path& path, TextureFileChange& out_change) {
+    if (!path.has_extension() || path.extension().string().back() == '~') {
+        return false;
+    }
+
+    const std::filesystem::path folder = path.parent_path().lexically_normal();
+    if (folder == std::filesystem::path(textures_path("albedo")).lexically_normal()) {
+        out_change.is_normal = false;
+    } else if (folder == std::filesystem::path(textures_path("normal")).lexically_normal()) {
+        out_change.is_normal = true;
+    } else {
+        return false;
+    }
+    out_change.name = path.stem().string();
+    return true;
+}
+
 /**
  * Handles all the OpenGL textures for the renderer during the lifetime of the program.
+ *
+ * All albedo textures on disk are packed into a single atlas texture at startup. Normal maps are packed into a
+ * second atlas with the exact same layout, so that a sprite can sample both with the same texture coordinates.
+ * Textures too large for the atlas are kept as standalone textures.
+ *
+ * Image files are read and decoded on a pool of worker threads. The atlas layout only depends on image dimensions,
+ * which are read from the file headers up front, so every texture can be referenced right away; until its pixels
+ * are uploaded by `pump` it shows up as a transparent placeholder.
  */
 class TextureManager {
+    /**
+     * Decoded RGBA8 pixels of an image, row by row starting from the top.
+     */
+    struct Image {
+        ivec2 size = {0, 0};
+        std::vector<uint8_t> pixels;
+
+        /**
+         * Images loaded from the texture cache are read straight from the memory-mapped cache file instead of
+         * being copied into `pixels`.
+         */
+        std::shared_ptr<MappedFile> mapped;
+        size_t mapped_offset = 0;
+
+        [[nodiscard]] const uint8_t* data() const { return mapped ? mapped->data() + mapped_offset : pixels.data(); }
+
+        [[nodiscard]] size_t byteSize() const { return static_cast<size_t>(size.x) * size.y * 4; }
+    };
+
+    /**
+     * A texture file on disk, and where it ended up in the atlas if it was packed into it.
+     */
+    struct TextureFile {
+        std::string name;
+        std::filesystem::path path;
+        ivec2 size = {0, 0};
+        bool in_atlas = false;
+        ivec2 atlas_position = {0, 0};
+    };
+
+    /**
+     * The decoded pixels of a texture file and its normal map, ready to be uploaded.
+     */
+    struct DecodedTexture {
+        TextureFile file;
+        Image albedo;
+        Image normal;
+    };
+
+    static constexpr int ATLAS_WIDTH = 2048;
+
+    /**
+     * Empty texels around every texture in the atlas so neighbours never bleed into each other.
+     */
+    static constexpr int ATLAS_PADDING = 1;
+
     bool initialized = false;
 
+    TextureHandle albedo_atlas = 0;
+    TextureHandle normal_atlas = 0;
+    ivec2 atlas_size = {0, 0};
+
+    std::unordered_map<std::string, TextureFile> albedo_files;
+    std::unordered_map<std::string, TextureFile> normal_files;
+
+    /**
+     * Textures that are not part of the atlas, including internal textures added through `add`.
+     */
     std::unordered_map<std::string, TextureHandle> textures;
 
+    std::unordered_map<std::string, TextureRegion> regions;
+
     std::unordered_map<std::string, VirtualTextureHandle> name_to_virtual;
-    std::unordered_map<VirtualTextureHandle, TextureHandle> virtual_to_actual;
+    std::vector<TextureRegion> virtual_regions = std::vector<TextureRegion>(1);
 
-    std::unordered_map<std::string, std::filesystem::file_time_type> write_times;
-    std::filesystem::file_time_type last_albedo_write_time;
-    std::filesystem::file_time_type last_normal_write_time;
+    std::mutex decoded_mutex;
+    std::vector<DecodedTexture> decoded;
+    size_t pending_uploads = 0;
 
-    size_t texture_count = 0;
+    /**
+     * Declared after the members its jobs use so that it is destroyed first, it finishes the queued decodes when
+     * destroyed.
+     */
+    std::unique_ptr<ThreadPool> decoder;
+
+    static std::unordered_map<std::string, TextureFile> listTextureFiles(const std::string& folder);
 
-    void addFromPath(const std::filesystem::directory_entry& entry);
+    /**
+     * Decode an image file. Decoded pixels are kept in the texture cache (see `cache_path`), and reused as long as
+     * the image file's write time and content hash don't change.
+     */
+    static bool decodeImage(const std::filesystem::path& path, Image& out_image);
+
+    static std::string cachedImagePath(const std::filesystem::path& path);
+
+    static bool loadCachedImage(const std::string& cached_path, int64_t source_write_time, uint64_t source_hash,
+                                Image& out_image);
+
+    static void writeCachedImage(const std::string& cached_path, int64_t source_write_time, uint64_t source_hash,
+                                 const Image& image);
+
+    static Image resizeImage(const Image& image, ivec2 size);
+
+    /**
+     * @param texture An existing texture to reallocate instead of creating a new one, if not 0
+     */
+    static TextureHandle createTexture(ivec2 size, const uint8_t* pixels, TextureHandle texture = 0);
+
+    /**
+     * Decode a texture file along with its normal map. Safe to call from worker threads.
+     * @param normal_path The normal map to decode, may be empty for standalone textures without a normal map
+     * @param decoded_normal The normal map's pixels if they were decoded already, e.g. a normal map many textures use
+     */
+    static DecodedTexture decodeTexture(const TextureFile& file, const std::filesystem::path& normal_path,
+                                        const Image* decoded_normal = nullptr);
+
+    /**
+     * Scan the texture folders, pack the atlas and upload all the textures.
+     */
+    void loadTextures();
+
+    void releaseTextures();
+
+    /**
+     * Get the normal map that should be decoded along with the given texture file.
+     */
+    [[nodiscard]] std::filesystem::path normalPath(const TextureFile& file) const;
+
+    /**
+     * Upload a decoded texture and its normal map into the textures reserved for it.
+     */
+    void uploadTexture(const DecodedTexture& texture);
+
+    /**
+     * Upload pixels into a texture, either replacing it entirely or only the rect at `position`.
+     */
+    static void uploadPixels(TextureHandle texture, ivec2 position, const Image& image, bool whole_texture);
+
+    void setRegion(const std::string& name, const TextureRegion& region);
 
   public:
     /**
@@ -43,6 +213,21 @@ class TextureManager {
      */
     void init();
 
+    /**
+     * Upload any textures that finished decoding since the last call. Should be called once every frame.
+     * @return whether any texture was uploaded
+     */
+    bool pump();
+
+    /**
+     * Whether some textures are still being decoded or waiting to be uploaded.
+     */
+    [[nodiscard]] bool loading() const { return pending_uploads > 0; }
+
+    /**
+     * Get the OpenGL texture holding the given texture's texels. For textures in the atlas this is the atlas itself,
+     * use `getRegion` to find out where the texture is inside of it.
+     */
     [[nodiscard]] TextureHandle get(const std::string& name) const;
 
     [[nodiscard]] TextureHandle get(VirtualTextureHandle virtual_handle) const;
@@ -53,6 +238,10 @@ class TextureManager {
      */
     [[nodiscard]] TextureHandle getNormal(const std::string& name) const;
 
+    [[nodiscard]] const TextureRegion& getRegion(const std::string& name) const;
+
+    [[nodiscard]] const TextureRegion& getRegion(VirtualTextureHandle virtual_handle) const;
+
     /**
      * Get the `VirtualTextureHandle` for a texture given its name.
      * @param name The name of the texture
@@ -68,9 +257,11 @@ class TextureManager {
     void add(const std::string& name, const TextureHandle& texture);
 
     /**
-     * Update any textures that have updated on disk since the last time the texture manager
-     * was initialized/updated.
-     * @return whether any textures were updated
+     * Reload the textures among the given changed files. Textures whose size didn't change are updated in place,
+     * otherwise the atlas is packed again. Must not be called while `loading`.
+     *
+     * @param changed_files Files that changed on disk, files outside of the texture folders are ignored
+     * @return the names of the textures whose region changed, which have to be looked up again
      */
-    bool update();
-};
\ No newline at end of file
+    std::set<std::string> update(const std::vector<std::filesystem::path>& changed_files);
+};
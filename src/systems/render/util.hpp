@@ -1,6 +1,8 @@
 #pragma once
 
 #include "common.hpp"
+#include "components.hpp"
+#include "utils/hash.hpp"
 
 inline mat3 createProjectionMatrix() {
     constexpr float left = 0.f;
@@ -16,6 +18,58 @@ inline mat3 createProjectionMatrix() {
     return {{sx, 0.f, 0.f}, {0.f, sy, 0.f}, {tx, ty, 1.f}};
 }
 
+/**
+ * How many entities a render stage drew and how many it skipped for being off screen in the last frame.
+ */
+struct CullStats {
+    size_t drawn = 0;
+    size_t culled = 0;
+};
+
+/**
+ * Whether anything of an entity drawn as a unit quad (sprites and meshes are both normalized to -0.5 ... 0.5) lies
+ * within the native view, given the motion's position, rotation and scale. Checks the axis aligned box around the
+ * rotated quad, so corners of the view can let a few entities through that are just off screen, but nothing visible
+ * is ever culled.
+ */
+inline bool isOnScreen(const Motion& motion) {
+    const float cos_angle = std::abs(std::cos(motion.angle));
+    const float sin_angle = std::abs(std::sin(motion.angle));
+    const vec2 scale = abs(motion.scale);
+    const vec2 half_extent =
+        0.5f * vec2(cos_angle * scale.x + sin_angle * scale.y, sin_angle * scale.x + cos_angle * scale.y);
+
+    return motion.position.x + half_extent.x >= 0.f && motion.position.x - half_extent.x <= native_width &&
+           motion.position.y + half_extent.y >= 0.f && motion.position.y - half_extent.y <= native_height;
+}
+
+/**
+ * Hash the parts of a motion that affect where things are drawn.
+ */
+inline uint64_t hashMotion(const Motion& motion, uint64_t hash) {
+    hash = raycast::hash::fnv1aValue(motion.position, hash);
+    hash = raycast::hash::fnv1aValue(motion.angle, hash);
+    return raycast::hash::fnv1aValue(motion.scale, hash);
+}
+
+/**
+ * Hash everything about a material that affects how it is drawn. The texture name is left out, the handles and
+ * region it resolves to are what counts.
+ */
+inline uint64_t hashMaterial(const Material& material, uint64_t hash) {
+    const TextureMaterial& texture = material.texture;
+    hash = raycast::hash::fnv1aValue(material.type, hash);
+    hash = raycast::hash::fnv1aValue(texture.albedo, hash);
+    hash = raycast::hash::fnv1aValue(texture.normal, hash);
+    hash = raycast::hash::fnv1aValue(texture.h_offset, hash);
+    hash = raycast::hash::fnv1aValue(texture.v_offset, hash);
+    hash = raycast::hash::fnv1aValue(texture.cell_size, hash);
+    hash = raycast::hash::fnv1aValue(texture.uv_rect, hash);
+    hash = raycast::hash::fnv1aValue(material.color, hash);
+    hash = raycast::hash::fnv1aValue(material.layer, hash);
+    return raycast::hash::fnv1aValue(material.blend_mode, hash);
+}
+
 inline vec2 screenToWorld(const vec2 screenPos) {
 #ifdef __EMSCRIPTEN__
     vec2 worldPos = vec2(screenPos.x, screenPos.y);
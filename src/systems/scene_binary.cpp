@@ -0,0 +1,439 @@
+#include "scene_binary.hpp"
+
+#include "logging/log.hpp"
+#include "utils/hash.hpp"
+#include "utils/mapped_file.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include <unordered_map>
+
+namespace {
+struct BlobHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t source_hash;
+    uint32_t entity_count;
+    uint32_t string_count;
+    uint32_t section_count;
+    uint32_t _padding;
+};
+
+struct SectionHeader {
+    uint32_t type;
+    uint32_t count;
+    // size of a component stored as it is in memory, 0 for components stored field by field
+    uint32_t element_size;
+    uint32_t byte_size;
+};
+
+// which entity a component belongs to, and which section it is in
+struct RecordRef {
+    uint32_t entity;
+    uint32_t type;
+};
+
+constexpr char SCENE_MAGIC[4] = {'R', 'S', 'C', 'N'};
+constexpr char BACKGROUND_MAGIC[4] = {'R', 'B', 'K', 'G'};
+
+// bump this whenever a component stored in these files changes
+constexpr uint32_t BLOB_VERSION = 2;
+
+// sections that don't hold components of a scene, component sections use the index of the component in
+// `SceneComponent` as their type
+constexpr uint32_t RECORDS_SECTION = 0xffff0000;
+constexpr uint32_t MAIN_BACKGROUND_SECTION = 0xffff0001;
+constexpr uint32_t BACKGROUND_SPRITES_SECTION = 0xffff0002;
+
+/**
+ * Lists the fields of components that can't be stored as they are in memory. The same function is used to both write
+ * and read them, `archive` is called with all the fields.
+ */
+template <typename Archive> void fields(Archive& archive, Sprite& c) {
+    archive(c.position, c.scale, c.angle, c.texture, c.color);
+}
+template <typename Archive> void fields(Archive& archive, ChangeScene& c) { archive(c.scene); }
+template <typename Archive> void fields(Archive& archive, Level& c) { archive(c.id, c.name); }
+template <typename Archive> void fields(Archive& archive, Mirror& c) {
+    archive(c.position, c.angle, c.mirrorType, c.railLength, c.railAngle, c.snap_segments, c.snap_angle);
+}
+template <typename Archive> void fields(Archive& archive, ButtonHelper& c) { archive(c.position, c.scale, c.label); }
+template <typename Archive> void fields(Archive& archive, SpriteSheetRecord& c) {
+    SpriteSheet& ss = c.sheet;
+    archive(ss.position, ss.sheetWidth, ss.sheetHeight, ss.cellWidth, ss.cellHeight, ss.animationFrames, c.texture,
+            c.image_width, c.image_height);
+}
+template <typename Archive> void fields(Archive& archive, Text& c) {
+    archive(c.text, c.position, c.size, c.color, c.layer, c.centered);
+}
+template <typename Archive> void fields(Archive& archive, MeshRecord& c) {
+    archive(c.path, c.position, c.angle, c.scale);
+}
+template <typename Archive> void fields(Archive& archive, BackgroundRecord& c) { archive(c.id); }
+template <typename Archive> void fields(Archive& archive, Setting& c) { archive(c.setting, c.position_y); }
+
+template <typename T> constexpr bool is_flat = std::is_trivially_copyable_v<T>;
+
+class BlobWriter {
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, uint32_t> string_ids;
+
+    std::vector<uint8_t> sections;
+    uint32_t section_count = 0;
+
+    size_t section_start = 0;
+
+  public:
+    template <typename... T> void operator()(const T&... values) { (put(values), ...); }
+
+    template <typename T> void put(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+        sections.insert(sections.end(), bytes, bytes + sizeof(T));
+    }
+
+    // strings are stored as their index in the string table
+    void put(const std::string& string) {
+        auto [it, inserted] = string_ids.try_emplace(string, static_cast<uint32_t>(strings.size()));
+        if (inserted) {
+            strings.push_back(string);
+        }
+        put(it->second);
+    }
+
+    void put(const std::vector<unsigned int>& values) {
+        put(static_cast<uint32_t>(values.size()));
+        for (const unsigned int value : values) {
+            put(value);
+        }
+    }
+
+    template <typename T> void put_component(const T& component) {
+        if constexpr (is_flat<T>) {
+            put(component);
+        } else {
+            // `fields` is shared with the reader, which needs to modify the component
+            fields(*this, const_cast<T&>(component));
+        }
+    }
+
+    void begin_section() {
+        section_start = sections.size();
+        put(SectionHeader{});
+    }
+
+    void end_section(const uint32_t type, const uint32_t count, const uint32_t element_size) {
+        const SectionHeader header = {type, count, element_size,
+                                      static_cast<uint32_t>(sections.size() - section_start - sizeof(SectionHeader))};
+        std::memcpy(sections.data() + section_start, &header, sizeof(header));
+        section_count++;
+    }
+
+    bool save(const std::string& path, const char (&magic)[4], const uint64_t source_hash,
+              const uint32_t entity_count) const {
+        std::error_code error;
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+
+        // write to a temporary file first, so a failed write never leaves a truncated file behind
+        const std::string temporary_path = path + ".tmp";
+        {
+            std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                return false;
+            }
+
+            BlobHeader header{};
+            std::memcpy(header.magic, magic, sizeof(header.magic));
+            header.version = BLOB_VERSION;
+            header.source_hash = source_hash;
+            header.entity_count = entity_count;
+            header.string_count = static_cast<uint32_t>(strings.size());
+            header.section_count = section_count;
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+            for (const std::string& string : strings) {
+                const auto length = static_cast<uint32_t>(string.size());
+                file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+                file.write(string.data(), length);
+            }
+            file.write(reinterpret_cast<const char*>(sections.data()), static_cast<std::streamsize>(sections.size()));
+            if (!file.good()) {
+                return false;
+            }
+        }
+        std::filesystem::rename(temporary_path, path, error);
+        return !error;
+    }
+};
+
+/**
+ * Reads values from part of a compiled file. Reading past the end sets `failed` instead of reading out of bounds.
+ */
+class BlobReader {
+    const uint8_t* cursor = nullptr;
+    const uint8_t* end = nullptr;
+    const std::vector<std::string>* strings = nullptr;
+
+  public:
+    bool failed = false;
+
+    BlobReader(const uint8_t* begin, const uint8_t* end, const std::vector<std::string>* strings)
+        : cursor(begin), end(end), strings(strings) {}
+
+    template <typename... T> void operator()(T&... values) { (get(values), ...); }
+
+    [[nodiscard]] const uint8_t* position() const { return cursor; }
+
+    bool skip(const size_t size) {
+        if (failed || static_cast<size_t>(end - cursor) < size) {
+            failed = true;
+            return false;
+        }
+        cursor += size;
+        return true;
+    }
+
+    template <typename T> void get(T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const uint8_t* start = cursor;
+        if (skip(sizeof(T))) {
+            std::memcpy(&value, start, sizeof(T));
+        }
+    }
+
+    void get(std::string& string) {
+        uint32_t id = 0;
+        get(id);
+        if (failed || id >= strings->size()) {
+            failed = true;
+            return;
+        }
+        string = (*strings)[id];
+    }
+
+    void get(std::vector<unsigned int>& values) {
+        uint32_t count = 0;
+        get(count);
+        if (failed || count > static_cast<size_t>(end - cursor) / sizeof(unsigned int)) {
+            failed = true;
+            return;
+        }
+        values.resize(count);
+        std::memcpy(values.data(), cursor, count * sizeof(unsigned int));
+        cursor += count * sizeof(unsigned int);
+    }
+
+    template <typename T> void get_component(T& component) {
+        if constexpr (is_flat<T>) {
+            get(component);
+        } else {
+            fields(*this, component);
+        }
+    }
+};
+
+template <typename T> constexpr uint32_t element_size() { return is_flat<T> ? sizeof(T) : 0; }
+
+struct Section {
+    SectionHeader header;
+    BlobReader reader;
+};
+
+/**
+ * The parts of a compiled file, once its header and string table were checked.
+ */
+struct Blob {
+    MappedFile file;
+    BlobHeader header{};
+    std::vector<std::string> strings;
+    std::unordered_map<uint32_t, Section> sections;
+
+    bool open(const std::string& path, const char (&magic)[4], const uint64_t source_hash) {
+        if (!file.open(path) || file.size() < sizeof(BlobHeader)) {
+            return false;
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, magic, sizeof(header.magic)) != 0 || header.version != BLOB_VERSION) {
+            LOG_WARN("Ignoring {}, it was compiled by a different version of the game", path);
+            return false;
+        }
+        if (header.source_hash != source_hash) {
+            LOG_WARN("Ignoring {}, it is out of date", path);
+            return false;
+        }
+
+        BlobReader reader(file.data() + sizeof(header), file.data() + file.size(), nullptr);
+        strings.resize(header.string_count);
+        for (std::string& string : strings) {
+            uint32_t length = 0;
+            reader.get(length);
+            const auto* characters = reinterpret_cast<const char*>(reader.position());
+            if (!reader.skip(length)) {
+                break;
+            }
+            string.assign(characters, length);
+        }
+
+        for (uint32_t i = 0; i < header.section_count && !reader.failed; i++) {
+            SectionHeader section_header{};
+            reader.get(section_header);
+            const uint8_t* data = reader.position();
+            if (!reader.skip(section_header.byte_size)) {
+                break;
+            }
+            sections.emplace(section_header.type,
+                             Section{section_header, BlobReader(data, data + section_header.byte_size, &strings)});
+        }
+
+        if (reader.failed) {
+            LOG_WARN("Ignoring {}, it is broken", path);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Get a section holding components of type `T`, or null if it doesn't exist or was written for a different
+     * layout of `T`.
+     */
+    template <typename T> Section* section(const uint32_t type) {
+        const auto it = sections.find(type);
+        if (it == sections.end() || it->second.header.element_size != element_size<T>()) {
+            return nullptr;
+        }
+        return &it->second;
+    }
+};
+
+template <size_t I = 0> void write_component_sections(BlobWriter& writer, const SceneIR& ir) {
+    if constexpr (I < std::variant_size_v<SceneComponent>) {
+        using T = std::variant_alternative_t<I, SceneComponent>;
+        uint32_t count = 0;
+        writer.begin_section();
+        for (const SceneRecord& record : ir.records) {
+            if (record.component.index() == I) {
+                writer.put_component(std::get<I>(record.component));
+                count++;
+            }
+        }
+        writer.end_section(I, count, element_size<T>());
+        write_component_sections<I + 1>(writer, ir);
+    }
+}
+
+/**
+ * Read the next component of the section of the given type into a new record.
+ */
+template <size_t I = 0> bool read_component(Blob& blob, const size_t type, SceneComponent& component) {
+    if constexpr (I < std::variant_size_v<SceneComponent>) {
+        if (type != I) {
+            return read_component<I + 1>(blob, type, component);
+        }
+        using T = std::variant_alternative_t<I, SceneComponent>;
+        Section* section = blob.section<T>(I);
+        if (section == nullptr) {
+            return false;
+        }
+        T& value = component.emplace<I>();
+        section->reader.get_component(value);
+        return !section->reader.failed;
+    } else {
+        return false;
+    }
+}
+} // namespace
+
+namespace scene_binary {
+std::string compiled_scene_path(const std::string& scene_tag) { return compiled_path("scenes/" + scene_tag + ".rscn"); }
+
+std::string compiled_background_path(const std::string& background_tag) {
+    return compiled_path("backgrounds/" + background_tag + ".rbkg");
+}
+
+uint64_t source_hash(const std::string& json_path) {
+    MappedFile file;
+    if (!file.open(json_path)) {
+        return 0;
+    }
+    return raycast::hash::fnv1a(file.data(), file.size());
+}
+
+bool write_scene(const std::string& path, const SceneIR& ir, const uint64_t source_hash) {
+    BlobWriter writer;
+    writer.begin_section();
+    for (const SceneRecord& record : ir.records) {
+        writer.put(RecordRef{record.entity, static_cast<uint32_t>(record.component.index())});
+    }
+    writer.end_section(RECORDS_SECTION, static_cast<uint32_t>(ir.records.size()), sizeof(RecordRef));
+
+    write_component_sections(writer, ir);
+    return writer.save(path, SCENE_MAGIC, source_hash, ir.entity_count);
+}
+
+bool write_background(const std::string& path, const BackgroundIR& background, const uint64_t source_hash) {
+    BlobWriter writer;
+    writer.begin_section();
+    writer.put(background.main_background);
+    writer.end_section(MAIN_BACKGROUND_SECTION, 1, 0);
+
+    writer.begin_section();
+    for (const Sprite& sprite : background.extras) {
+        writer.put_component(sprite);
+    }
+    writer.end_section(BACKGROUND_SPRITES_SECTION, static_cast<uint32_t>(background.extras.size()),
+                       element_size<Sprite>());
+    return writer.save(path, BACKGROUND_MAGIC, source_hash, 0);
+}
+
+bool read_scene(const std::string& path, const uint64_t source_hash, SceneIR& ir) {
+    Blob blob;
+    if (!blob.open(path, SCENE_MAGIC, source_hash)) {
+        return false;
+    }
+
+    Section* records = blob.section<RecordRef>(RECORDS_SECTION);
+    if (records == nullptr) {
+        return false;
+    }
+
+    ir.entity_count = blob.header.entity_count;
+    ir.records.clear();
+    ir.records.resize(records->header.count);
+    for (SceneRecord& record : ir.records) {
+        RecordRef ref{};
+        records->reader.get(ref);
+        record.entity = ref.entity;
+        if (records->reader.failed || ref.entity >= ir.entity_count ||
+            !read_component(blob, ref.type, record.component)) {
+            LOG_WARN("Ignoring {}, it is broken", path);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool read_background(const std::string& path, const uint64_t source_hash, BackgroundIR& background) {
+    Blob blob;
+    if (!blob.open(path, BACKGROUND_MAGIC, source_hash)) {
+        return false;
+    }
+
+    Section* main = blob.section<std::string>(MAIN_BACKGROUND_SECTION);
+    Section* sprites = blob.section<Sprite>(BACKGROUND_SPRITES_SECTION);
+    if (main == nullptr || sprites == nullptr) {
+        return false;
+    }
+
+    main->reader.get(background.main_background);
+    background.extras.resize(sprites->header.count);
+    for (Sprite& sprite : background.extras) {
+        sprites->reader.get_component(sprite);
+    }
+    if (main->reader.failed || sprites->reader.failed) {
+        LOG_WARN("Ignoring {}, it is broken", path);
+        return false;
+    }
+    return true;
+}
+} // namespace scene_binary
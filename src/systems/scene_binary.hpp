@@ -0,0 +1,34 @@
+#pragma once
+
+#include "scene_ir.hpp"
+
+#include <cstdint>
+#include <string>
+
+/**
+ * Binary version of scene and background files, written by the `raycast_scenec` tool. JSON stays the format scenes
+ * are written in; the binary files only save parsing it when the game loads.
+ *
+ * A file holds, after its header:
+ *   - a table of the strings used by its components (texture names, labels, ...), every string stored only once
+ *   - one section per component type, holding all components of that type in a flat array. Components without
+ *     strings or other heap data are stored as they are in memory and read back with a single `memcpy`.
+ *   - for scenes, a section listing which entity every component belongs to, in the order of the scene file
+ *
+ * Every file stores the hash of the JSON file it was compiled from, so stale files are detected and ignored.
+ */
+namespace scene_binary {
+// compiled file of the scene or background with the given tag
+std::string compiled_scene_path(const std::string& scene_tag);
+std::string compiled_background_path(const std::string& background_tag);
+
+// hash of a JSON source file, 0 if it can't be read
+uint64_t source_hash(const std::string& json_path);
+
+bool write_scene(const std::string& path, const SceneIR& ir, uint64_t source_hash);
+bool write_background(const std::string& path, const BackgroundIR& background, uint64_t source_hash);
+
+// Load a compiled file into `ir`. Fails if the file is missing, broken or was compiled from a different JSON file.
+bool read_scene(const std::string& path, uint64_t source_hash, SceneIR& ir);
+bool read_background(const std::string& path, uint64_t source_hash, BackgroundIR& background);
+} // namespace scene_binary
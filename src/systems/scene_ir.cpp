@@ -0,0 +1,123 @@
+#include "scene_ir.hpp"
+
+#include "components_json.hpp"
+#include "json.hpp"
+#include "logging/log.hpp"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <string_view>
+
+namespace {
+
+// Parse a scene file entry into a `T` and record it for the given entity.
+template <typename T>
+void parse_record(const nlohmann::json& data, uint32_t entity, SceneIR& ir) {
+    SceneRecord& record = ir.records.emplace_back(SceneRecord{entity, SceneComponent(std::in_place_type<T>)});
+    data.get_to(std::get<T>(record.component));
+}
+
+using ParseRecord = void (*)(const nlohmann::json&, uint32_t, SceneIR&);
+
+struct RecordParser {
+    std::string_view type;
+    ParseRecord parse;
+};
+
+// Find the parser for the given scene file entry type, nullptr if there is none. The table is generated from
+// `RAYCAST_SCENE_COMPONENTS` and sorted once, so looking a type up is a binary search over string views instead of
+// comparing against every type in turn.
+ParseRecord find_record_parser(std::string_view type) {
+#define RECORD_PARSER(name, ty) RecordParser{name, &parse_record<ty>},
+    static const auto parsers = [] {
+        std::array parsers = {RAYCAST_SCENE_COMPONENTS(RECORD_PARSER)};
+        std::sort(parsers.begin(), parsers.end(),
+                  [](const RecordParser& a, const RecordParser& b) { return a.type < b.type; });
+        return parsers;
+    }();
+#undef RECORD_PARSER
+
+    auto it = std::lower_bound(parsers.begin(), parsers.end(), type,
+                               [](const RecordParser& parser, std::string_view type) { return parser.type < type; });
+    return it != parsers.end() && it->type == type ? it->parse : nullptr;
+}
+
+} // namespace
+
+bool parse_scene(std::istream& in, const std::string& filename, SceneIR& ir) {
+    // Iterate through every entity specified, and record the component
+    // specified
+    try {
+        nlohmann::json j;
+        in >> j;
+
+        for (auto& array : j["objList"]) {
+            const uint32_t entity = ir.entity_count++;
+            for (const auto& data : array["data"]) {
+                // Entries of unknown types are ignored
+                if (ParseRecord parse = find_record_parser(data.at("type").get_ref<const std::string&>())) {
+                    parse(data, entity, ir);
+                }
+            }
+        }
+    // catches all errors deriving from the standard exception class, this is better than a catch(...) statement since it gives
+    // us information about the error via e.what()
+    } catch (const std::exception& e) {
+        LOG_ERROR("Parsing file {} failed with error: {}\n", filename, e.what());
+        return false;
+
+    // catches any other error -- practically this case should never be reached since its good practice to have all errors extend the std::exception class
+    } catch (...) {
+        LOG_ERROR("Parsing file {} failed with an unknown error, check formatting\n", filename);
+        return false;
+    }
+
+    return true;
+}
+
+bool parse_scene_file(const std::string& filename, SceneIR& ir) {
+    std::ifstream entity_file(filename);
+    if (!entity_file.is_open()) {
+        LOG_ERROR("Failed to open file: {}\n", filename);
+        return false;
+    }
+
+    return parse_scene(entity_file, filename, ir);
+}
+
+bool parse_background_file(const std::string& filename, BackgroundIR& parsed) {
+    std::ifstream background_file(filename);
+    if (!background_file.is_open()) {
+        LOG_ERROR("Failed to open file: {}\n", filename);
+        return false;
+    }
+
+    try {
+        nlohmann::json j;
+        background_file >> j;
+
+        j["background"].get_to(parsed.main_background);
+        for (auto& data : j["extra"]) {
+            Sprite sprite{};
+            data["position"][0].get_to(sprite.position.x);
+            data["position"][1].get_to(sprite.position.y);
+            data["scale"][0].get_to(sprite.scale.x);
+            data["scale"][1].get_to(sprite.scale.y);
+            data["texture"].get_to(sprite.texture);
+            parsed.extras.push_back(sprite);
+        }
+        // catches all errors deriving from the standard exception class, this is better than a catch(...) statement since it gives
+        // us information about the error via e.what()
+    } catch (const std::exception& e) {
+        LOG_ERROR("Parsing file {} failed with error: {}\n", filename, e.what());
+        return false;
+
+        // catches any other error -- practically this case should never be reached since its good practice to have all errors extend the std::exception class
+    } catch (...) {
+        LOG_ERROR("Parsing file {} failed with an unknown error, check formatting\n", filename);
+        return false;
+    }
+
+    return true;
+}
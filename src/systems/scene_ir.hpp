@@ -0,0 +1,64 @@
+#pragma once
+
+#include "common.hpp"
+#include "components.hpp"
+#include "components_list.hpp"
+
+#include <filesystem>
+#include <istream>
+#include <variant>
+#include <vector>
+
+/**
+ * Everything a scene file entry can turn into, see `RAYCAST_SCENE_COMPONENTS`. Records are never left empty, the
+ * `std::monostate` is only there so the list can be expanded with a leading comma.
+ */
+#define SCENE_COMPONENT_ALTERNATIVE(name, ty) , ty
+using SceneComponent = std::variant<std::monostate RAYCAST_SCENE_COMPONENTS(SCENE_COMPONENT_ALTERNATIVE)>;
+#undef SCENE_COMPONENT_ALTERNATIVE
+
+/**
+ * A component to add to one of the entities of a scene.
+ */
+struct SceneRecord {
+    /** Index of the entity among the scene's entities, in the order they appear in the scene file */
+    uint32_t entity = 0;
+    SceneComponent component;
+};
+
+/**
+ * A scene file parsed into the components it creates, so the scene can be loaded again without touching the JSON.
+ */
+struct SceneIR {
+    uint32_t entity_count = 0;
+    std::vector<SceneRecord> records;
+
+    /** Write time of the scene file this was parsed from, to notice when it is edited */
+    std::filesystem::file_time_type write_time;
+
+    /**
+     * How many components every registry container held once the scene was loaded, see
+     * `ECSRegistry::component_counts`. Empty until the scene is loaded for the first time, afterwards the containers
+     * are reserved to exactly this size before loading it again.
+     */
+    std::vector<uint32_t> component_counts;
+};
+
+/**
+ * A background file parsed into the sprites it creates.
+ */
+struct BackgroundIR {
+    std::string main_background;
+    std::vector<Sprite> extras;
+    std::filesystem::file_time_type write_time;
+};
+
+// Parse the JSON of a scene from `in` into `ir`, `filename` is only used in error messages. Returns true if
+// successful. False if not.
+bool parse_scene(std::istream& in, const std::string& filename, SceneIR& ir);
+
+// Parse a scene file into `ir`. Returns true if successful. False if not.
+bool parse_scene_file(const std::string& filename, SceneIR& ir);
+
+// Parse a background file into `background`. Returns true if successful. False if not.
+bool parse_background_file(const std::string& filename, BackgroundIR& background);
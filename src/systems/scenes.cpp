@@ -1,22 +1,16 @@
 #include "scenes.hpp"
 
 #include "common.hpp"
-#include "components_json.hpp"
-#include "json.hpp"
 #include "menu.hpp"
+#include "mesh_utils.hpp"
 #include "registry.hpp"
+#include "scene_binary.hpp"
 #include "world_init.hpp"
+#include "utils/time.hpp"
 
 #include <filesystem>
-#include <fstream>
 #include <iostream>
 
-// NOTE: Expects the `data`, `entity`, and `registry` identifiers to be in scope.
-#define PARSE_COMPONENT(ty, container)                                         \
-ty __ty{};                                                                     \
-data.get_to(__ty);                                                             \
-(registry).container.insert(entity, __ty);
-
 namespace fs = std::filesystem;
 
 void SceneSystem::init(Entity &scene_state_entity, PersistenceSystem *persistence_ptr) {
@@ -50,157 +44,230 @@ void SceneSystem::init(Entity &scene_state_entity, PersistenceSystem *persistenc
     }
 
     background.init();
+    prefetcher = std::make_unique<ThreadPool>(1);
 }
 
-// Attempts to parse a specified scene. Returns true if successful. False if
-// not.
-bool SceneSystem::try_parse_scene(std::string& scene_tag) {
-    std::string filename = scene_paths.at(scene_tag);
-    std::ifstream entity_file(filename);
-
-    if (entity_file.is_open()) {
-        nlohmann::json j;
-        entity_file >> j;
-
-        entity_file.close();
-
-        // Iterate through every entity specified, and add the component
-        // specified
-        try {
-            for (auto& array : j["objList"]) {
-                const auto entity = Entity();
-                for (auto& data : array["data"]) {
-                    std::string type = data["type"];
-                    if (type == "sprite") {
-                        Sprite c{};
-                        data.get_to(c);
-                        createSprite(entity, c.position, c.scale, c.angle, c.texture, FOREGROUND, c.color);
-                    } else if (type == "change_scene") {
-                        PARSE_COMPONENT(ChangeScene, changeScenes);
-                    } else if (type == "zone") {
-                        Zone c{};
-                        data.get_to(c);
-                        setZone(entity, c.type, c.position);
-                    } else if (type == "light_source") {
-                        PARSE_COMPONENT(LightSource, lightSources);
-                    } else if (type == "lerpable") {
-                        PARSE_COMPONENT(Lerpable, lerpables);
-                    } else if (type == "reflective") {
-                        PARSE_COMPONENT(Reflective, reflectives);
-                    } else if (type == "level") {
-                        PARSE_COMPONENT(Level, levels);
-                    } else if (type == "mirror") {
-                        Mirror c{};
-                        data.get_to(c);
-                        createMirror(entity, c);
-                    } else if (type == "highlightable") {
-                        PARSE_COMPONENT(Highlightable, highlightables);
-                    } else if (type == "level_select") {
-                        PARSE_COMPONENT(LevelSelect, levelSelects);
-                    } else if (type == "dash_the_turtle") {
-                        //createDashTheTurtle(entity, data["position"]);
-                        PARSE_COMPONENT(DashTheTurtle, turtles);
-                        // int x = registry.motions.has(entity);
-                        // printf("Your boolean variable is: %s\n", x ? "true" : "false");
-                    } else if (type == "button") {
-                        ButtonHelper c{};
-                        data.get_to(c);
-                        createEmptyButton(entity, c.position, c.scale, c.label);
-                    } else if (type == "collider") {
-                        PARSE_COMPONENT(Collider, colliders);
-                    } else if (type == "collideable") {
-                        PARSE_COMPONENT(Collideable, collideables);
-                    } else if (type == "interactable") {
-                        PARSE_COMPONENT(Interactable, interactables);
-                    } else if (type == "blackhole") {
-                        PARSE_COMPONENT(Blackhole, blackholes);
-                        // the blackhole is itself a point light source as well
-                        PointLight& point_light = registry.pointLights.emplace(entity);
-                        point_light.diffuse = 6.0f * vec3(255, 233, 87);
-                        point_light.linear = -0.25f; // the render magic lies in this value
-                        point_light.quadratic = 0.01;
-                    } else if (type == "sprite_sheet") {
-                        SpriteSheet ss{};
-                        data.get_to(ss);
-                        createSpriteSheet(entity, ss.position, ss.sheetWidth, ss.sheetHeight, ss.cellWidth,
-                                          ss.cellHeight, ss.animationFrames, data["texture"], data["imageWidth"],
-                                          data["imageHeight"]);
-                    } else if (type == "minisun") {
-                        PARSE_COMPONENT(MiniSun, minisuns);
-                    } else if (type == "gravity") {
-                        PARSE_COMPONENT(Gravity, gravities);
-                    } else if (type == "menu_item") {
-                        PARSE_COMPONENT(MenuItem, menuItems);
-                    } else if (type == "text") {
-                        PARSE_COMPONENT(Text, texts);
-                    } else if (type == "lever") { // This is used to attach a lever entity that can exhibit some effect on the CURRENT ENTITY
-                        createLever(entity, data["position"], data["state"], data["effect"], data["activeLever"]);
-                    } else if (type == "mesh") {
-                        initMesh(entity, data["path"], data["position"], data["angle"], data["scale"]);
-                    } else if (type == "delete_data") {
-                        PARSE_COMPONENT(DeleteData, deleteDatas);
-                    } else if (type == "background") {
-                        std::string background_tag;
-                        data["id"].get_to(background_tag);
-                        background.try_parse_background(background_tag);
-                    } else if (type == "portal_pair") {
-                        createPortals(data["portal_position"], data["portal_angle"], data["other_portal_position"], data["other_portal_angle"]);
-                    } else if (type == "end_level") {
-                        PARSE_COMPONENT(EndLevel, endLevels);
-                    } else if (type == "end_cutscene_count") {
-                        EndCutsceneCount end{};
-                        data.get_to(end);
-                        registry.endCutsceneCounts.insert(entity, end);
-                        Motion motion{};
-                        motion.position = end.position;
-                        motion.scale = {3, 3};
-                        registry.motions.insert(entity, motion);
-                    } else if (type == "ambient_light") {
-                        PARSE_COMPONENT(AmbientLight, ambientLights);
-                    } else if (type == "setting") {
-                        Setting setting{};
-                        data.get_to(setting);
-                        if (setting.setting == "music") {
-                            registry.texts.insert(entity, {"Music Volume", {120, setting.position_y}, 36, vec4(255.0), UI_TEXT, true});
-                            int index = floor(persistence->get_settings_music_volume() * 26);
-                            if (index > 25) index = 25;
-                            std::string slider_texture = "slider" + std::to_string(index);
-                            createEmptyButton(entity, {200, setting.position_y}, {52, 10}, "", slider_texture);
-                            registry.volumeSliders.insert(entity, {setting.setting});
-                        } else if (setting.setting == "sfx") {
-                            registry.texts.insert(entity, {"SFX Volume", {120, setting.position_y}, 36, vec4(255.0), UI_TEXT, true});
-                            int index = floor(persistence->get_settings_sfx_volume() * 26);
-                            if (index > 25) index = 25;
-                            std::string slider_texture = "slider" + std::to_string(index);
-                            createEmptyButton(entity, {200, setting.position_y}, {52, 10}, "", slider_texture);
-                            registry.volumeSliders.insert(entity, {setting.setting});
-                        } else if (setting.setting == "hard") {
-                            registry.texts.insert(entity, {"Hard Mode", {120, setting.position_y}, 36, vec4(255.0), UI_TEXT, true});
-                            int index = persistence->get_settings_hard_mode();
-                            std::string toggle_texture = "toggle" + std::to_string(index);
-                            createEmptyButton(entity, {200, setting.position_y}, {10, 10}, "", toggle_texture);
-                            registry.toggles.insert(entity, {setting.setting});
-                        }
-                    }
-                }
-            }
-        // catches all errors deriving from the standard exception class, this is better than a catch(...) statement since it gives
-        // us information about the error via e.what()
-        } catch (const std::exception& e) {
-            LOG_ERROR("Parsing file {} failed with error: {}\n", filename, e.what());
+namespace {
+/**
+ * Adds a single scene record to the registry, `std::visit`ed with every record of a scene.
+ */
+struct SceneReplay {
+    const Entity& entity;
+    BackgroundSystem& background;
+    PersistenceSystem* persistence;
+
+    // Components that have a container in the registry are added to it as they are, the overloads below handle
+    // the ones that need more setup
+    template <typename T>
+    void operator()(const T& c) const { registry.get<T>().insert(entity, c); }
+
+    void operator()(std::monostate) const {}
+
+    void operator()(const Sprite& c) const {
+        createSprite(entity, c.position, c.scale, c.angle, c.texture, FOREGROUND, c.color);
+    }
+
+    void operator()(const Zone& c) const { setZone(entity, c.type, c.position); }
+
+    void operator()(const Mirror& c) const { createMirror(entity, c); }
+
+    void operator()(const ButtonHelper& c) const { createEmptyButton(entity, c.position, c.scale, c.label); }
+
+    void operator()(const Blackhole& c) const {
+        registry.blackholes.insert(entity, c);
+        // the blackhole is itself a point light source as well
+        PointLight& point_light = registry.pointLights.emplace(entity);
+        point_light.diffuse = 6.0f * vec3(255, 233, 87);
+        point_light.linear = -0.25f; // the render magic lies in this value
+        point_light.quadratic = 0.01;
+    }
+
+    void operator()(const SpriteSheetRecord& c) const {
+        const SpriteSheet& ss = c.sheet;
+        createSpriteSheet(entity, ss.position, ss.sheetWidth, ss.sheetHeight, ss.cellWidth, ss.cellHeight,
+                          ss.animationFrames, c.texture, c.image_width, c.image_height);
+    }
+
+    void operator()(const LeverRecord& c) const {
+        createLever(entity, c.position, c.state, c.effect, c.active_lever);
+    }
+
+    void operator()(const MeshRecord& c) const { initMesh(entity, c.path, c.position, c.angle, c.scale); }
+
+    void operator()(const BackgroundRecord& c) const {
+        std::string background_tag = c.id;
+        background.try_parse_background(background_tag);
+    }
+
+    void operator()(const PortalPairRecord& c) const {
+        createPortals(c.position, c.angle, c.other_position, c.other_angle);
+    }
+
+    void operator()(const EndCutsceneCount& c) const {
+        registry.endCutsceneCounts.insert(entity, c);
+        Motion motion{};
+        motion.position = c.position;
+        motion.scale = {3, 3};
+        registry.motions.insert(entity, motion);
+    }
+
+    void operator()(const Setting& setting) const {
+        if (setting.setting == "music") {
+            registry.texts.insert(entity, {"Music Volume", {120, setting.position_y}, 36, vec4(255.0), UI_TEXT, true});
+            int index = floor(persistence->get_settings_music_volume() * 26);
+            if (index > 25) index = 25;
+            std::string slider_texture = "slider" + std::to_string(index);
+            createEmptyButton(entity, {200, setting.position_y}, {52, 10}, "", slider_texture);
+            registry.volumeSliders.insert(entity, {setting.setting});
+        } else if (setting.setting == "sfx") {
+            registry.texts.insert(entity, {"SFX Volume", {120, setting.position_y}, 36, vec4(255.0), UI_TEXT, true});
+            int index = floor(persistence->get_settings_sfx_volume() * 26);
+            if (index > 25) index = 25;
+            std::string slider_texture = "slider" + std::to_string(index);
+            createEmptyButton(entity, {200, setting.position_y}, {52, 10}, "", slider_texture);
+            registry.volumeSliders.insert(entity, {setting.setting});
+        } else if (setting.setting == "hard") {
+            registry.texts.insert(entity, {"Hard Mode", {120, setting.position_y}, 36, vec4(255.0), UI_TEXT, true});
+            int index = persistence->get_settings_hard_mode();
+            std::string toggle_texture = "toggle" + std::to_string(index);
+            createEmptyButton(entity, {200, setting.position_y}, {10, 10}, "", toggle_texture);
+            registry.toggles.insert(entity, {setting.setting});
+        } else if (setting.setting == "bloom") {
+            // the button shows the quality level, so the caption needs an entity of its own
+            Entity caption;
+            registry.texts.insert(caption, {"Bloom", {120, setting.position_y}, 36, vec4(255.0), UI_TEXT, true});
+            int index = persistence->get_settings_bloom_quality();
+            createEmptyButton(entity, {200, setting.position_y}, {30, 10}, BLOOM_QUALITY_NAMES[index]);
+            registry.texts.get(entity).size = 36;
+            registry.toggles.insert(entity, {setting.setting});
+        }
+    }
+};
+} // namespace
+
+void SceneSystem::replay_scene(const SceneIR& ir) {
+    std::vector<Entity> entities(ir.entity_count);
+    for (const SceneRecord& record : ir.records) {
+        std::visit(SceneReplay{entities[record.entity], background, persistence}, record.component);
+    }
+}
+
+bool SceneSystem::load_scene(const std::string& scene_tag, SceneIR& ir, const char*& source) const {
+    const std::string& filename = scene_paths.at(scene_tag);
+
+    // prefer the compiled scene, the JSON is only parsed if it is missing or out of date
+    source = "compiled";
+    if (!scene_binary::read_scene(scene_binary::compiled_scene_path(scene_tag), scene_binary::source_hash(filename),
+                                  ir)) {
+        source = "parsed";
+        ir = {};
+        if (!parse_scene_file(filename, ir)) {
             return false;
-        
-        // catches any other error -- practically this case should never be reached since its good practice to have all errors extend the std::exception class
-        } catch (...) {
-            LOG_ERROR("Parsing file {} failed with an unknown error, check formatting\n", filename);
+        }
+    }
+    std::error_code error;
+    ir.write_time = fs::last_write_time(filename, error);
+    return true;
+}
+
+void SceneSystem::prefetch(const std::vector<std::string>& scene_tags) {
+    for (const std::string& scene_tag : scene_tags) {
+        if (scene_paths.count(scene_tag) == 0 || scene_cache.count(scene_tag) != 0 ||
+            prefetching.count(scene_tag) != 0) {
+            continue;
+        }
+
+        // std::function has to be copyable, so the promise is shared with the job instead of moved into it
+        auto promise = std::make_shared<std::promise<PrefetchedScene>>();
+        prefetching.emplace(scene_tag, promise->get_future());
+        prefetcher->submit([this, scene_tag, promise] { promise->set_value(prefetch_scene(scene_tag)); });
+    }
+}
+
+SceneSystem::PrefetchedScene SceneSystem::prefetch_scene(const std::string& scene_tag) const {
+    const auto start = raycast::time::Clock::now();
+    PrefetchedScene prefetched;
+    const char* source = "";
+    prefetched.loaded = load_scene(scene_tag, prefetched.ir, source);
+
+    // Textures are all loaded at startup, backgrounds and meshes are what else a scene waits for
+    for (const SceneRecord& record : prefetched.ir.records) {
+        if (const auto* background_record = std::get_if<BackgroundRecord>(&record.component)) {
+            BackgroundIR background_ir;
+            if (background.load_background(background_record->id, background_ir)) {
+                prefetched.backgrounds.emplace_back(background_record->id, std::move(background_ir));
+            }
+        } else if (const auto* mesh = std::get_if<MeshRecord>(&record.component)) {
+            MeshUtils::preload(mesh_path(mesh->path));
+        }
+    }
+
+    LOG_INFO("Prefetched scene {} in {:.2f} ms ({})", scene_tag, raycast::time::ms_since(start), source);
+    return prefetched;
+}
+
+bool SceneSystem::take_prefetched(const std::string& scene_tag, SceneIR& ir) {
+    auto it = prefetching.find(scene_tag);
+    if (it == prefetching.end()) {
+        return false;
+    }
+    PrefetchedScene prefetched = it->second.get();
+    prefetching.erase(it);
+
+    for (auto& [background_tag, background_ir] : prefetched.backgrounds) {
+        background.add_prefetched(background_tag, std::move(background_ir));
+    }
+    if (!prefetched.loaded) {
+        return false;
+    }
+    ir = std::move(prefetched.ir);
+    return true;
+}
+
+// Attempts to load a specified scene. Returns true if successful. False if
+// not. Scene files are only parsed the first time they are loaded, or after they changed.
+bool SceneSystem::try_parse_scene(std::string& scene_tag, const std::vector<Entity>& kept) {
+    const auto start = raycast::time::Clock::now();
+    const std::string& filename = scene_paths.at(scene_tag);
+
+    auto cached = scene_cache.find(scene_tag);
+    std::error_code error;
+    if (cached != scene_cache.end() && fs::last_write_time(filename, error) != cached->second.write_time) {
+        scene_cache.erase(cached);
+        cached = scene_cache.end();
+    }
+
+    const char* source = "cached";
+    if (cached == scene_cache.end()) {
+        SceneIR ir;
+        if (take_prefetched(scene_tag, ir)) {
+            source = "prefetched";
+        } else if (!load_scene(scene_tag, ir, source)) {
+            // the background entities go away with the rest, they must not be kept by the next scene
+            background.clear_background();
+            registry.clear_all_components_except(kept);
             return false;
         }
+        cached = scene_cache.emplace(scene_tag, std::move(ir)).first;
     }
-    else {
-        LOG_ERROR("Failed to open file: {}\n", filename);
+
+    // Only remove what the new scene doesn't have in common with the current one
+    std::vector<Entity> kept_entities = kept;
+    std::string background_tag;
+    for (const SceneRecord& record : cached->second.records) {
+        if (const auto* background_record = std::get_if<BackgroundRecord>(&record.component)) {
+            background_tag = background_record->id;
+        }
     }
+    background.keep_if_unchanged(background_tag, kept_entities);
+    registry.clear_all_components_except(kept_entities);
+
+    registry.reserve(cached->second.component_counts);
+    replay_scene(cached->second);
+    cached->second.component_counts = registry.component_counts();
 
-    LOG_INFO("Successfully loaded scene\n");
+    LOG_INFO("Loaded scene {} in {:.2f} ms ({}, kept {} entities)", scene_tag, raycast::time::ms_since(start), source,
+             kept_entities.size());
     return true;
 }
 
@@ -5,14 +5,20 @@
 #include "common.hpp"
 #include "persistence.hpp"
 #include "render.hpp"
+#include "scene_ir.hpp"
+#include "thread_pool.hpp"
+#include <future>
 #include <map>
+#include <memory>
+#include <unordered_map>
 
 class SceneSystem {
   public:
     void init(Entity &scene_state_entity, PersistenceSystem *persistence_ptr);
 
-    // add entities
-    bool try_parse_scene(std::string &scene_tag);
+    // Replace the current scene's entities with the given scene's. The given entities, and those the two scenes have
+    // in common (the background, if it is the same), are kept as they are instead of being removed and created again.
+    bool try_parse_scene(std::string &scene_tag, const std::vector<Entity>& kept = {});
 
     size_t level_count() {
         return levels.size();
@@ -20,10 +26,41 @@ class SceneSystem {
 
     void reload_background(std::string& background_tag);
 
+    // Start loading the given scenes, along with the backgrounds and meshes they use, on a worker thread, so that
+    // switching to one of them later only has to add its components. Scenes that are unknown, already loaded or
+    // already being prefetched are skipped.
+    void prefetch(const std::vector<std::string>& scene_tags);
+
   private:
+    // A scene loaded ahead of time by `prefetch`
+    struct PrefetchedScene {
+        bool loaded = false;
+        SceneIR ir;
+        std::vector<std::pair<std::string, BackgroundIR>> backgrounds;
+    };
+
     BackgroundSystem background;
     PersistenceSystem *persistence;
 
+    // Scenes parsed so far, by tag
+    std::unordered_map<std::string, SceneIR> scene_cache;
+
+    // Scenes being prefetched, by tag
+    std::unordered_map<std::string, std::future<PrefetchedScene>> prefetching;
+
+    void replay_scene(const SceneIR& ir);
+
+    // Load a scene from its compiled file, or its JSON file if there is no up-to-date compiled file. Only reads
+    // `scene_paths`, so it can be called from the prefetch thread.
+    bool load_scene(const std::string& scene_tag, SceneIR& ir, const char*& source) const;
+
+    // Runs on the prefetch thread
+    PrefetchedScene prefetch_scene(const std::string& scene_tag) const;
+
+    // Take the result of prefetching a scene, waiting for it if it is not done yet. Returns false if the scene was
+    // not prefetched, or failed to load.
+    bool take_prefetched(const std::string& scene_tag, SceneIR& ir);
+
     std::map<std::string, std::string> levels {
         // dynamically allocated
     };
@@ -35,4 +72,7 @@ class SceneSystem {
         {"gamefinish", scene_path("gamefinish.json")},
         {"settings", scene_path("settings.json")},
     };
+
+    // Declared last so that it is destroyed first, its queued jobs still use the members above
+    std::unique_ptr<ThreadPool> prefetcher;
 };
@@ -1,6 +1,7 @@
 #include "sounds.hpp"
 
 #include <SDL.h>
+#include <chrono>
 #include <filesystem>
 #include "common.hpp"
 
@@ -16,33 +17,29 @@ void SoundSystem::init() {
     if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048) == -1) {
         LOG_ERROR("Failed to open audio device");
     }
+
+    Mix_AllocateChannels(SFX_CHANNELS);
 }
 
 void SoundSystem::load_all_sounds() {
-    // Load background music
-    background_music = Mix_LoadMUS(music_path(BGM_FILENAME).c_str());
-
-    if (background_music == nullptr) {
-        LOG_ERROR("Failed to load music: {} make sure the file path exists", BGM_FILENAME);
-        throw std::runtime_error("Failed to load music: " + BGM_FILENAME);
-    }
+    // Sound effects are decoded on this thread, so the main thread never waits for the disk unless a sound is played
+    // before it was preloaded. Mix_LoadWAV only reads the format of the opened audio device, so it can run here.
+    decoder = std::make_unique<ThreadPool>(1);
 
     active_music = NONE;
-
-    forest_sounds = Mix_LoadMUS(music_path(FS_FILENAME).c_str());
-
-    if (forest_sounds == nullptr) {
-        LOG_ERROR("Failed to load music: {} make sure the file path exists", FS_FILENAME);
-        throw std::runtime_error("Failed to load music: " + FS_FILENAME);
-    }
-
     play_background();
 
-    // Load all sound effects
-    load_chunks();
+    // Find all sound effects
+    find_chunks();
 }
 
 void SoundSystem::free_sounds() {
+    // Wait for the sound effects that are still decoding, before freeing them
+    decoder.reset();
+
+    LOG_INFO("Sound effects: {} plays, {} rate limited, {} voices stolen, {} loads, {} evictions", stats.plays,
+             stats.rate_limited, stats.stolen, stats.loads, stats.evictions);
+
     // Free background music
     if (background_music != nullptr)
         Mix_FreeMusic(background_music);
@@ -50,57 +47,213 @@ void SoundSystem::free_sounds() {
     if (forest_sounds != nullptr)
         Mix_FreeMusic(forest_sounds);
 
+    Mix_HaltChannel(-1);
+
     // Free all chunks
-    for (const auto& [filename, chunk] : sfxs) {
-        if (chunk != nullptr)
-            Mix_FreeChunk(chunk);
+    for (Sound& sound : sfxs) {
+        if (sound.decoding.valid()) {
+            loaded(sound, sound.decoding.get());
+        }
+        if (sound.chunk != nullptr)
+            Mix_FreeChunk(sound.chunk);
     }
 
     sfxs.clear();
+    sfx_ids.clear();
 
     Mix_CloseAudio();
     Mix_Quit();
 }
 
-void SoundSystem::load_chunks() {
+void SoundSystem::find_chunks() {
     const fs::path sfx_dir = sfx_dir_path();
 
     for (const auto& entry : fs::directory_iterator(sfx_dir)) {
         const auto filename = entry.path().filename().string();
 
-        Mix_Chunk* chunk = Mix_LoadWAV(sfx_path(filename).c_str());
+        sfx_ids.emplace(filename, static_cast<SoundId>(sfxs.size()));
+        sfxs.emplace_back().filename = filename;
+    }
+}
 
-        if (chunk == nullptr) {
-            LOG_ERROR("Failed to load sound effect: {} make sure the file path exists", filename);
-            throw std::runtime_error("Failed to load sound effect: " + filename);
-        }
+void SoundSystem::step() {
+    frame++;
 
-        sfxs.emplace(filename, chunk);
+    for (Sound& sound : sfxs) {
+        if (sound.decoding.valid() &&
+            sound.decoding.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            loaded(sound, sound.decoding.get());
+        }
     }
+
+    evict_over_budget();
 }
 
-void SoundSystem::play_sound(const std::string& filename, const float volume_multiplier) {
-    const auto it = sfxs.find(filename);
-    if (it == sfxs.end()) {
+SoundId SoundSystem::sound_id(const std::string& filename) {
+    const auto it = sfx_ids.find(filename);
+    if (it == sfx_ids.end()) {
         LOG_ERROR("Sound effect not found: {}", filename);
+        return INVALID_SOUND;
+    }
+    return it->second;
+}
+
+void SoundSystem::preload(const std::vector<SoundId>& ids) {
+    for (SoundId id : ids) {
+        if (id >= sfxs.size()) continue;
+
+        Sound& sound = sfxs[id];
+        if (sound.chunk != nullptr || sound.failed || sound.decoding.valid()) continue;
+
+        // std::function has to be copyable, so the promise is shared with the job instead of moved into it
+        auto promise = std::make_shared<std::promise<Mix_Chunk*>>();
+        sound.decoding = promise->get_future();
+        decoder->submit([path = sfx_path(sound.filename), promise] {
+            promise->set_value(Mix_LoadWAV(path.c_str()));
+        });
+    }
+}
+
+Mix_Chunk* SoundSystem::acquire(SoundId id) {
+    Sound& sound = sfxs[id];
+    if (sound.chunk == nullptr && !sound.failed) {
+        // Wait for the decoder if the sound was preloaded, otherwise decode it right away
+        loaded(sound, sound.decoding.valid() ? sound.decoding.get() : Mix_LoadWAV(sfx_path(sound.filename).c_str()));
+    }
+    return sound.chunk;
+}
+
+void SoundSystem::loaded(Sound& sound, Mix_Chunk* chunk) {
+    if (chunk == nullptr) {
+        LOG_ERROR("Failed to load sound effect: {} make sure the file path exists", sound.filename);
+        sound.failed = true;
+        return;
+    }
+
+    sound.chunk = chunk;
+    loaded_bytes += chunk->alen;
+    stats.loads++;
+}
+
+int SoundSystem::pick_channel(SoundId id) {
+    int oldest_voice = -1;
+    int oldest_channel = -1;
+    int free_channel = -1;
+    int voice_count = 0;
+
+    for (int channel = 0; channel < SFX_CHANNELS; channel++) {
+        const Voice& voice = voices[channel];
+        if (!Mix_Playing(channel)) {
+            if (free_channel == -1) free_channel = channel;
+            continue;
+        }
+
+        if (voice.sound == id) {
+            voice_count++;
+            if (oldest_voice == -1 || voice.started < voices[oldest_voice].started) oldest_voice = channel;
+        }
+        if (oldest_channel == -1 || voice.started < voices[oldest_channel].started) oldest_channel = channel;
+    }
+
+    // Take over the oldest voice of the sound if it plays too often, or the oldest voice of any sound if every
+    // channel is busy
+    int channel = free_channel;
+    if (voice_count >= MAX_VOICES_PER_SOUND) {
+        channel = oldest_voice;
+    } else if (channel == -1) {
+        channel = oldest_channel;
+    }
+
+    if (channel != free_channel) {
+        Mix_HaltChannel(channel);
+        stats.stolen++;
+    }
+    return channel;
+}
+
+void SoundSystem::evict_over_budget() {
+    if (loaded_bytes <= SFX_MEMORY_BUDGET) return;
+
+    // Sounds that are playing can't be freed
+    std::vector<bool> playing(sfxs.size(), false);
+    for (int channel = 0; channel < SFX_CHANNELS; channel++) {
+        if (voices[channel].sound != INVALID_SOUND && Mix_Playing(channel)) playing[voices[channel].sound] = true;
+    }
+
+    while (loaded_bytes > SFX_MEMORY_BUDGET) {
+        Sound* least_recent = nullptr;
+        for (SoundId id = 0; id < sfxs.size(); id++) {
+            Sound& sound = sfxs[id];
+            if (sound.chunk == nullptr || playing[id]) continue;
+            if (least_recent == nullptr || sound.last_played < least_recent->last_played) least_recent = &sound;
+        }
+        if (least_recent == nullptr) return;
+
+        loaded_bytes -= least_recent->chunk->alen;
+        Mix_FreeChunk(least_recent->chunk);
+        least_recent->chunk = nullptr;
+        stats.evictions++;
+    }
+}
+
+void SoundSystem::play_sound(const SoundId id, const float volume_multiplier) {
+    if (id >= sfxs.size()) return;
+
+    const int volume = static_cast<int>(MIX_MAX_VOLUME * volume_multiplier * sfx_volume);
+    Sound& sound = sfxs[id];
+
+    // Playing a sound several times in the same frame only makes it louder, so the voice that already plays it is
+    // reused at the loudest of the volumes instead
+    if (sound.last_played == frame && sound.last_channel != -1 && voices[sound.last_channel].sound == id &&
+        Mix_Playing(sound.last_channel)) {
+        if (volume > Mix_Volume(sound.last_channel, -1)) Mix_Volume(sound.last_channel, volume);
+        stats.rate_limited++;
         return;
     }
 
-    Mix_Chunk* sfx_to_play = it->second;
+    Mix_Chunk* sfx_to_play = acquire(id);
+    if (sfx_to_play == nullptr) return;
 
-    Mix_VolumeChunk(sfx_to_play, static_cast<int>(MIX_MAX_VOLUME * volume_multiplier * sfx_volume));
-    Mix_PlayChannel(-1, sfx_to_play, 0);
+    const int channel = pick_channel(id);
+    Mix_Volume(channel, volume);
+    if (Mix_PlayChannel(channel, sfx_to_play, 0) == -1) return;
+
+    voices[channel] = Voice{id, ++play_count};
+    sound.last_played = frame;
+    sound.last_channel = channel;
+    stats.plays++;
+}
+
+void SoundSystem::play_sound(const std::string& filename, const float volume_multiplier) {
+    play_sound(sound_id(filename), volume_multiplier);
 }
 
 void SoundSystem::play_background() {
     if (active_music == MAIN) return;
 
+    // Music is streamed from its file while it plays, so it is only opened once it is first played
+    if (background_music == nullptr) {
+        background_music = Mix_LoadMUS(music_path(BGM_FILENAME).c_str());
+        if (background_music == nullptr) {
+            LOG_ERROR("Failed to load music: {} make sure the file path exists", BGM_FILENAME);
+            return;
+        }
+    }
+
     Mix_VolumeMusic(MIX_MAX_VOLUME * BGM_VOLUME_MULTIPLIER * music_volume);
     Mix_PlayMusic(background_music, -1);
     active_music = MAIN;
 }
 
 void SoundSystem::play_forest() {
+    if (forest_sounds == nullptr) {
+        forest_sounds = Mix_LoadMUS(music_path(FS_FILENAME).c_str());
+        if (forest_sounds == nullptr) {
+            LOG_ERROR("Failed to load music: {} make sure the file path exists", FS_FILENAME);
+            return;
+        }
+    }
+
     Mix_VolumeMusic(MIX_MAX_VOLUME * FS_VOLUME_MULTIPLIER * music_volume);
     Mix_FadeInMusic(forest_sounds, -1, 200);
     active_music = FOREST;
@@ -4,14 +4,31 @@
 #define SOUNDS_H
 
 #include <SDL_mixer.h>
+#include <cstdint>
+#include <future>
+#include <memory>
 #include <unordered_map>
 #include <string>
+#include <vector>
+
+#include "thread_pool.hpp"
 
 constexpr float BGM_VOLUME_MULTIPLIER = 0.3;
 const std::string BGM_FILENAME = "Arcade-Puzzler.wav";
 constexpr float FS_VOLUME_MULTIPLIER = 0.5;
 const std::string FS_FILENAME = "ForestAmbient.wav";
 
+// Number of sound effects that can play at the same time
+constexpr int SFX_CHANNELS = 16;
+// Voices of the same sound effect that can play at the same time, further plays take over the oldest one
+constexpr int MAX_VOICES_PER_SOUND = 3;
+// Decoded sound effects are evicted, least recently played first, to stay under this
+constexpr size_t SFX_MEMORY_BUDGET = 16 * 1024 * 1024;
+
+// Index of a sound effect, see `SoundSystem::sound_id`
+typedef uint32_t SoundId;
+constexpr SoundId INVALID_SOUND = UINT32_MAX;
+
 enum CurrentMusic {
     MAIN,
     FOREST,
@@ -33,7 +50,7 @@ class SoundSystem {
         static void init();
 
         /**
-         * Load BGM and SFX and play BGM
+         * Find the sound effects and play BGM. Sound effects are only decoded once they are preloaded or played.
          */
         void load_all_sounds();
 
@@ -42,6 +59,33 @@ class SoundSystem {
          */
         void free_sounds();
 
+        /**
+         * Call once per frame. Picks up sound effects that finished decoding, and evicts the least recently played ones
+         * while over `SFX_MEMORY_BUDGET`.
+         */
+        void step();
+
+        /**
+         * Get the ID of a sound effect, to play it without looking it up by name every time.
+         * @param filename - use filename with extension. For example: "my_sound.wav".
+         * @return the ID, or INVALID_SOUND if there is no such sound effect
+         */
+        SoundId sound_id(const std::string& filename);
+
+        /**
+         * Start decoding the given sound effects on the decoder thread, so they are ready when they are first played.
+         */
+        void preload(const std::vector<SoundId>& ids);
+
+        /**
+         * Play a sound effect. Playing a sound that is already playing from earlier this frame only raises the volume
+         * of that voice, and a sound playing `MAX_VOICES_PER_SOUND` times already takes over its oldest voice.
+         *
+         * @param id                - the sound to play, from `sound_id`
+         * @param volume_multiplier - float value from 0 to 1. 0 being muted, 1 being max volume. Defaults to 1.
+         */
+        void play_sound(SoundId id, float volume_multiplier = 1);
+
         /**
          * @param filename          - use filename with extension. For example: "my_sound.wav".
          * @param volume_multiplier - float value from 0 to 1. 0 being muted, 1 being max volume. Defaults to 1.
@@ -57,13 +101,63 @@ class SoundSystem {
         void change_volume_sfx(float volume);
 
       private:
-
-        std::unordered_map<std::string, Mix_Chunk*> sfxs;
+        struct Sound {
+            std::string filename;
+            Mix_Chunk* chunk = nullptr;
+            // set while the decoder thread decodes the sound
+            std::future<Mix_Chunk*> decoding;
+            bool failed = false;
+            // frame the sound was last played in
+            uint64_t last_played = 0;
+            // channel of the newest voice of the sound, -1 if it was never played
+            int last_channel = -1;
+        };
+
+        // What every mixer channel is playing, or last played
+        struct Voice {
+            SoundId sound = INVALID_SOUND;
+            uint64_t started = 0;
+        };
+
+        std::vector<Sound> sfxs;
+        std::unordered_map<std::string, SoundId> sfx_ids;
+        std::vector<Voice> voices = std::vector<Voice>(SFX_CHANNELS);
+        size_t loaded_bytes = 0;
+
+        // counts frames for rate limiting and the LRU, starts at 1 so no sound counts as played this frame
+        uint64_t frame = 1;
+        // counts plays, to find the oldest voice
+        uint64_t play_count = 0;
+
+        struct Stats {
+            size_t plays = 0;
+            size_t rate_limited = 0;
+            size_t stolen = 0;
+            size_t loads = 0;
+            size_t evictions = 0;
+        } stats;
+
+        std::unique_ptr<ThreadPool> decoder;
 
         float sfx_volume = 0.7;
         float music_volume = 0.7;
 
-        void load_chunks();
+        void find_chunks();
+
+        /**
+         * Get the decoded sound, waiting for the decoder or decoding it right away if needed. Returns nullptr if it
+         * failed to load.
+         */
+        Mix_Chunk* acquire(SoundId id);
+
+        void loaded(Sound& sound, Mix_Chunk* chunk);
+
+        /**
+         * Pick the channel to play a new voice of the given sound on, stopping whatever plays on it
+         */
+        int pick_channel(SoundId id);
+
+        void evict_over_budget();
 };
 
 #endif //SOUNDS_H
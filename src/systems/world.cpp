@@ -114,6 +114,14 @@ void WorldSystem::init(PersistenceSystem *persistence_ptr) {
     scenes.init(scene_state_entity, persistence_ptr);
     sounds.load_all_sounds();
 
+    sfx.win = sounds.sound_id("win.wav");
+    sfx.light_collision = sounds.sound_id("light-collision.wav");
+    sfx.reflection = sounds.sound_id("reflection-lower.wav");
+    sfx.lever = sounds.sound_id("lever.wav");
+    sfx.portal = sounds.sound_id("portal_long.wav");
+    sfx.click = sounds.sound_id("click.wav");
+    sounds.preload({sfx.win, sfx.light_collision, sfx.reflection, sfx.lever, sfx.portal, sfx.click});
+
     // Set all states to default
     restart_game();
 }
@@ -157,6 +165,8 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
         restart_game();
     }
 
+    sounds.step();
+
     // fade level name text and background
     if (registry.texts.has(level_name_text)) {
         Text& name_text = registry.texts.get(level_name_text);
@@ -270,6 +280,7 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 
 // Reset the world state to its initial state
 void WorldSystem::restart_game() {
+    restart_start = raycast::time::Clock::now();
     input_manager.active_entities.clear();
     // Debugging for memory/component leaks
     registry.list_all_components();
@@ -281,19 +292,18 @@ void WorldSystem::restart_game() {
     // Reset light respawn timer
     next_light_spawn = 0.f;
 
-    // Remove all entities that we created
-    registry.clear_all_components();
-
-    // Debugging for memory/component leaks
-    registry.list_all_components();
-
-    // Parse scene file
+    // Remove all entities that we created, and parse the scene file. The frame counter, and whatever the scenes have
+    // in common, is kept.
     if (registry.scenes.has(scene_state_entity)) {
-        scenes.try_parse_scene(registry.scenes.get(scene_state_entity).scene_tag);
+        scenes.try_parse_scene(registry.scenes.get(scene_state_entity).scene_tag, {frame_rate_entity});
     } else {
         LOG_ERROR("Hmm, there should have been a scene state entity defined.");
+        registry.clear_all_components();
     }
 
+    // Debugging for memory/component leaks
+    registry.list_all_components();
+
     if (!registry.levelSelects.components.empty()) {
         menus.generate_level_select_buttons((int)scenes.level_count());
     }
@@ -308,6 +318,8 @@ void WorldSystem::restart_game() {
     // display_level_name();
     // LOG_INFO(registry.levels.size() >= 1);
     if (registry.levels.size() == 1) {
+        prefetch_after_level(registry.levels.components[0].id);
+
         LOG_INFO("Initializing level named {}", registry.levels.components[0].name);
         level_name_bg = Entity();
         level_name_text = Entity();
@@ -333,9 +345,24 @@ void WorldSystem::restart_game() {
         text.color.w = 650.f;
     }
 
-    // add frame counter
-    frame_rate_entity = Entity();
-    registry.texts.insert(frame_rate_entity, {"", {1, 5}, 32, vec4(255.0), UI_TEXT, false});
+    // add frame counter, unless it was kept from the previous scene
+    if (!registry.texts.has(frame_rate_entity)) {
+        frame_rate_entity = Entity();
+        registry.texts.insert(frame_rate_entity, {"", {1, 5}, 32, vec4(255.0), UI_TEXT, false});
+    }
+}
+
+void WorldSystem::prefetch_after_level(int level_id) {
+    // the win popup leads to the next level or back to the menus, beating the last level starts the ending
+    const std::string next = level_id == (int)scenes.level_count() ? "end1" : "level" + std::to_string(level_id + 1);
+    scenes.prefetch({next, "levelmenu", "mainmenu"});
+}
+
+void WorldSystem::on_frame_drawn() {
+    if (restart_start.has_value()) {
+        LOG_INFO("Restart took {:.2f} ms until the first frame", raycast::time::ms_since(*restart_start));
+        restart_start.reset();
+    }
 }
 
 void WorldSystem::change_scene(std::string& scene_tag) {
@@ -346,43 +373,37 @@ void WorldSystem::change_scene(std::string& scene_tag) {
 }
 
 // Handle collisions between entities
-void WorldSystem::handle_collisions() {
-    // registry.collisions.emplace_with_duplicates(Entity(), Entity());
+void WorldSystem::handle_collisions(const std::vector<CollisionEvent>& events) {
     // Loop over all collisions detected by the physics system
-    auto& collisionsRegistry = registry.collisions;
-    for (int i = 0; i < collisionsRegistry.entities.size(); i++) {
-        if (registry.portals.has(collisionsRegistry.entities[i]) &&
-            registry.lightRays.has(collisionsRegistry.components[i].other)) {
-            handle_portal_collisions(collisionsRegistry.entities[i], collisionsRegistry.components[i].other);
+    for (CollisionEvent event : events) {
+        // an earlier collision this step may have removed the light ray
+        if (event.pair != COLLISION_PAIR::TURTLE_BARRIER && !registry.lightRays.has(event.other)) {
             continue;
         }
 
-        // Ignore Turtle to Light ray collision
-        if (registry.turtles.has(collisionsRegistry.entities[i]) &&
-            !registry.lightRays.has(collisionsRegistry.components[i].other)) {
-            handle_turtle_collisions(i);
-            continue;
-        }
-        // for now, only handle collisions involving light ray as other object
-        if (!registry.lightRays.has(collisionsRegistry.components[i].other) ||
-            registry.lightRays.has(collisionsRegistry.entities[i]))
-            continue;
-        if (registry.reflectives.has(collisionsRegistry.entities[i])) {
-            handle_reflection(collisionsRegistry.entities[i], collisionsRegistry.components[i].other,
-                              collisionsRegistry.components[i].side, collisionsRegistry.components[i].overlap);
-        } else {
-            
-            if (registry.minisuns.has(collisionsRegistry.entities[i])) {
-                handle_minisun_collision(collisionsRegistry.entities[i]);
-            } else if (registry.endCutsceneCounts.has(collisionsRegistry.entities[i])) {
-                handle_end_cutscene_collision(collisionsRegistry.entities[i]);
-            }
-            handle_non_reflection(collisionsRegistry.entities[i], collisionsRegistry.components[i].other);
+        switch (event.pair) {
+        case COLLISION_PAIR::PORTAL_LIGHT:
+            handle_portal_collisions(event.entity, event.other);
+            break;
+        case COLLISION_PAIR::TURTLE_BARRIER:
+            handle_turtle_collisions(event.entity, event.other);
+            break;
+        case COLLISION_PAIR::LIGHT_REFLECTION:
+            handle_reflection(event.entity, event.other, event.side, event.overlap);
+            break;
+        case COLLISION_PAIR::MINISUN_LIGHT:
+            handle_minisun_collision(event.entity);
+            handle_non_reflection(event.entity, event.other);
+            break;
+        case COLLISION_PAIR::END_CUTSCENE_LIGHT:
+            handle_end_cutscene_collision(event.entity);
+            handle_non_reflection(event.entity, event.other);
+            break;
+        case COLLISION_PAIR::LIGHT_ABSORBED:
+            handle_non_reflection(event.entity, event.other);
+            break;
         }
     }
-
-    // Remove all collisions from this simulation step
-    registry.collisions.clear();
 }
 
 void WorldSystem::handle_minisun_collision(Entity& minisun_entity) {
@@ -434,11 +455,12 @@ void WorldSystem::handle_non_reflection(Entity& collider, Entity& other) {
                         std::string tag = "end1";
                         change_scene(tag);
                     } else {
+                        prefetch_after_level(level.id);
                         menus.generate_level_win_popup(level.id, (int)scenes.level_count());
                         persistence->set_beaten(level.id);
                         persistence->set_accessible(level.id + 1);
                         persistence->try_write_save();
-                        sounds.play_sound("win.wav");
+                        sounds.play_sound(sfx.win);
                     }
                 }
             } else if (registry.endLevels.size() > 0) {
@@ -454,7 +476,7 @@ void WorldSystem::handle_non_reflection(Entity& collider, Entity& other) {
             return;
         }
         default: {
-            sounds.play_sound("light-collision.wav");
+            sounds.play_sound(sfx.light_collision);
             ParticleSystem::createLightDissipation(registry.motions.get(other));
             registry.remove_all_components_of(other);
             break;
@@ -462,7 +484,7 @@ void WorldSystem::handle_non_reflection(Entity& collider, Entity& other) {
         }
     } else {
         if (!registry.turtles.has(collider)) {
-            sounds.play_sound("light-collision.wav");
+            sounds.play_sound(sfx.light_collision);
             registry.remove_all_components_of(other);
         }
     }
@@ -517,7 +539,7 @@ void WorldSystem::handle_reflection(Entity& reflective, Entity& reflected, int s
 
     // Play reflection sound
     //sounds.play_sound("light-collision.wav");
-    sounds.play_sound("reflection-lower.wav", 0.15f);
+    sounds.play_sound(sfx.reflection, 0.15f);
 
 
     // Correct light position with overlap
@@ -533,11 +555,7 @@ void WorldSystem::handle_reflection(Entity& reflective, Entity& reflected, int s
 }
 
 // if the turtle collides against a wall, stop the turtle from moving further
-void WorldSystem::handle_turtle_collisions(int i) {
-
-    auto& collisionsRegistry = registry.collisions;
-    Entity turtle = collisionsRegistry.entities[i];
-    Entity other = collisionsRegistry.components[i].other;
+void WorldSystem::handle_turtle_collisions(Entity turtle, Entity other) {
 
     // TODO: Rough patch to handle TRIPLE COLLISIONS... might want to improve in the future
     if (!registry.motions.has(other) || !registry.colliders.has(other)) {
@@ -570,7 +588,7 @@ void WorldSystem::handle_turtle_collisions(int i) {
             if (registry.levers.has(other)) {
                 Lever& l = registry.levers.get(other);
                 if (l.sfx_timer <= 0.f) {
-                    sounds.play_sound("lever.wav");
+                    sounds.play_sound(sfx.lever);
                     l.sfx_timer = sounds.lever_sfx_duration_ms;
                 }
 
@@ -586,7 +604,7 @@ void WorldSystem::handle_turtle_collisions(int i) {
             if (registry.levers.has(other)) {
                 Lever& l = registry.levers.get(other);
                 if (l.sfx_timer <= 0.f) {
-                    sounds.play_sound("lever.wav");
+                    sounds.play_sound(sfx.lever);
                     l.sfx_timer = sounds.lever_sfx_duration_ms;
                 }
 
@@ -636,7 +654,7 @@ void WorldSystem::handle_portal_collisions(Entity& portal, Entity& light) {
     float dot_product = dot(light_direction, portal_normal);
     if (dot_product > 0) {
         // Light collided with the backside
-        sounds.play_sound("light-collision.wav");
+        sounds.play_sound(sfx.light_collision);
         registry.remove_all_components_of(light);
         return;
     }
@@ -655,12 +673,12 @@ void WorldSystem::handle_portal_collisions(Entity& portal, Entity& light) {
     // Remove and create new light at exit portal position
     registry.remove_all_components_of(light);
     createLight(light, exit_portal.position + exit_position_offset, exit_portal.angle + exit_angle_offset);
-    sounds.play_sound("portal_long.wav", 0.25);
+    sounds.play_sound(sfx.portal, 0.25);
 }
 
 
 // Should the game be over?
-bool WorldSystem::is_over() const { return bool(glfwWindowShouldClose(window)); }
+bool WorldSystem::is_over() const { return window != nullptr && glfwWindowShouldClose(window); }
 
 // On key callback
 void WorldSystem::on_key(int key, int, int action, int mod) {
@@ -822,13 +840,13 @@ void WorldSystem::on_mouse_button(int key, int action, int mod, double xpos, dou
         for (const Entity& entity : hovered_entities) {
             assert(registry.motions.has(entity));
             if (registry.changeScenes.has(entity) && input_manager.active_entities.size() == 0) {
-                sounds.play_sound("click.wav", 0.6f);
+                sounds.play_sound(sfx.click, 0.6f);
                 ChangeScene& changeScene = registry.changeScenes.get(entity);
                 change_scene(changeScene.scene);
                 break;
             }
             if (registry.resumeGames.has(entity)) {
-                sounds.play_sound("click.wav", 0.6f);
+                sounds.play_sound(sfx.click, 0.6f);
                 menus.try_close_menu();
                 break;
             }
@@ -872,6 +890,10 @@ void WorldSystem::on_mouse_button(int key, int action, int mod, double xpos, dou
                     int index = persistence->get_settings_hard_mode();
                     std::string toggle_texture = "toggle" + std::to_string(index);
                     m.texture = get_tex(toggle_texture);
+                } else if (t.setting == "bloom") {
+                    int index = (persistence->get_settings_bloom_quality() + 1) % std::size(BLOOM_QUALITY_NAMES);
+                    persistence->set_settings_bloom_quality(index);
+                    registry.texts.get(entity).text = BLOOM_QUALITY_NAMES[index];
                 }
             }
         }
@@ -4,6 +4,7 @@
 #include "common.hpp"
 
 // stlib
+#include <optional>
 #include <random>
 #include <vector>
 #define SDL_MAIN_HANDLED
@@ -17,6 +18,7 @@
 #include "scenes.hpp"
 #include "sounds.hpp"
 #include "utils/input_manager.hpp"
+#include "utils/time.hpp"
 
 constexpr size_t LIGHT_SPAWN_DELAY_MS = 1000.f;
 constexpr size_t DOUBLE_REFLECTION_TIMEOUT = 800.f;
@@ -40,13 +42,16 @@ class WorldSystem {
     bool step(float elapsed_ms);
 
     // Check for collisions
-    void handle_collisions();
+    void handle_collisions(const std::vector<CollisionEvent>& events);
 
     void handle_minisun_collision(Entity& minisun_entity);
 
     // Should the game be over ?
     bool is_over() const;
 
+    // Called after a frame was drawn, logs how long the last restart took to show up on screen
+    void on_frame_drawn();
+
 
   private:
     InputManager input_manager;
@@ -61,17 +66,20 @@ class WorldSystem {
     // Handle different collision cases
     void handle_reflection(Entity& reflective, Entity& reflected, int side, float overlap);
     void handle_non_reflection(Entity& collider, Entity& other);
-    void handle_turtle_collisions(int i);
+    void handle_turtle_collisions(Entity turtle, Entity other);
     void handle_portal_collisions(Entity& portal, Entity& light);
 
     void handle_end_cutscene_collision(Entity& end_cutscene_count_entity);
 
     // Restart level
     void restart_game();
+
+    // Start loading the scenes the player can go to after beating the given level
+    void prefetch_after_level(int level_id);
     void change_scene(std::string &scene_tag);
 
     // OpenGL window handle
-    GLFWwindow* window;
+    GLFWwindow* window = nullptr;
 
     // Time to fire
     float next_light_spawn;
@@ -88,6 +96,16 @@ class WorldSystem {
     // Music references
     SoundSystem sounds;
 
+    // Sound effects the world plays, resolved once in init
+    struct {
+        SoundId win = INVALID_SOUND;
+        SoundId light_collision = INVALID_SOUND;
+        SoundId reflection = INVALID_SOUND;
+        SoundId lever = INVALID_SOUND;
+        SoundId portal = INVALID_SOUND;
+        SoundId click = INVALID_SOUND;
+    } sfx;
+
     // C++ random number generator
     std::default_random_engine rng;
     std::uniform_real_distribution<float> uniform_dist; // number between 0..1
@@ -98,6 +116,9 @@ class WorldSystem {
     bool frame_rate_enabled = false;
     bool do_restart = false;
 
+    // When the last restart started, until its first frame was drawn
+    std::optional<raycast::time::Clock::time_point> restart_start;
+
     bool shouldStep();
     bool shouldAllowInput();
     static bool isInLevel();
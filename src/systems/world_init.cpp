@@ -42,19 +42,8 @@ Entity createLight(const Entity& entity, vec2 position, float dir) {
     point_light.linear = 0.045f;
     point_light.quadratic = 0.0075;
 
-    ParticleSpawner spawner;
-    spawner.texture = texture_manager.getVirtual("light");
-    spawner.initial_speed = 0.0f;
-    spawner.spin_velocity = 0.0f;
-    spawner.direction = vec2(0, 1);
-    spawner.color = vec4(1.7, 1.7, 0, 1);
-    spawner.spread = 0.0f;
-    spawner.initial_scale = vec2(8, 8);
-    spawner.scale_change = -15.f;
-    spawner.alpha_change = -1.7f;
-    spawner.lifetime = 1;
-    spawner.max_particles = 8;
-    registry.particleSpawners.insert(light, spawner);
+    LightTrail& trail = registry.lightTrails.emplace(Entity(), light);
+    trail.texture = texture_manager.getVirtual("light");
 
     return entity;
 }
@@ -262,6 +251,7 @@ void initMesh(const Entity& entity, const std::string& mesh_name, const vec2& po
     const auto filename = mesh_path(mesh_name);
     // Load mesh
     Mesh mesh{};
+    mesh.name = filename;
     MeshUtils::loadFromOBJFile(filename, mesh.vertices, mesh.vertex_indices, mesh.original_size);
     registry.meshes.insert(entity, mesh);
 
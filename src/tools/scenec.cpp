@@ -0,0 +1,151 @@
+/**
+ * raycast_scenec: compiles the scene and background JSON files into the binary files the game loads instead, see
+ * scene_binary.hpp. Run it from the directory the game runs from, it compiles everything in ./data.
+ *
+ * `raycast_scenec --bench [entities]` instead times loading a synthetic scene of the given number of entities
+ * (10000 by default), made by repeating the entities of the levels in ./data, from JSON and from a compiled file.
+ */
+
+#include "common.hpp"
+#include "json.hpp"
+#include "logging/log.hpp"
+#include "logging/log_manager.hpp"
+#include "scene_binary.hpp"
+#include "utils/time.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+size_t compiled = 0;
+size_t failed = 0;
+
+void compile_scene(const fs::path& path) {
+    SceneIR ir;
+    const std::string output = scene_binary::compiled_scene_path(path.stem().string());
+    if (!parse_scene_file(path.string(), ir) ||
+        !scene_binary::write_scene(output, ir, scene_binary::source_hash(path.string()))) {
+        LOG_ERROR("Failed to compile scene {}", path.string());
+        failed++;
+        return;
+    }
+    LOG_INFO("{} -> {} ({} entities, {} components)", path.string(), output, ir.entity_count, ir.records.size());
+    compiled++;
+}
+
+void compile_background(const fs::path& path) {
+    BackgroundIR background;
+    const std::string output = scene_binary::compiled_background_path(path.stem().string());
+    if (!parse_background_file(path.string(), background) ||
+        !scene_binary::write_background(output, background, scene_binary::source_hash(path.string()))) {
+        LOG_ERROR("Failed to compile background {}", path.string());
+        failed++;
+        return;
+    }
+    LOG_INFO("{} -> {}", path.string(), output);
+    compiled++;
+}
+
+// Runs `f` `runs` times and returns the fastest run in ms.
+template <typename F>
+float best_of(const int runs, F f) {
+    float best = std::numeric_limits<float>::max();
+    for (int i = 0; i < runs; i++) {
+        const auto start = raycast::time::Clock::now();
+        f();
+        best = std::min(best, raycast::time::ms_since(start));
+    }
+    return best;
+}
+
+int bench(const size_t entity_count) {
+    // the entities of every level, repeated until there are enough of them
+    nlohmann::json level_entities = nlohmann::json::array();
+    for (const auto& entry : fs::directory_iterator(scene_path("levels"))) {
+        std::ifstream file(entry.path());
+        nlohmann::json level = nlohmann::json::parse(file, nullptr, false);
+        if (level.is_discarded() || !level.contains("objList")) {
+            continue;
+        }
+        for (auto& entity : level["objList"]) {
+            level_entities.push_back(std::move(entity));
+        }
+    }
+    if (level_entities.empty()) {
+        LOG_ERROR("No level entities to build the benchmark scene from");
+        return EXIT_FAILURE;
+    }
+
+    nlohmann::json scene;
+    auto& entities = scene["objList"] = nlohmann::json::array();
+    for (size_t i = 0; i < entity_count; i++) {
+        entities.push_back(level_entities[i % level_entities.size()]);
+    }
+    const std::string text = scene.dump();
+
+    constexpr int RUNS = 5;
+    SceneIR ir;
+    // summed up and printed so the parses being timed can't be optimized away
+    size_t checksum = 0;
+    const float dom_ms = best_of(RUNS, [&] {
+        const nlohmann::json dom = nlohmann::json::parse(text);
+        checksum += dom.size();
+    });
+    const float parse_ms = best_of(RUNS, [&] {
+        ir = SceneIR{};
+        std::istringstream in(text);
+        parse_scene(in, "benchmark", ir);
+    });
+
+    const std::string output = scene_binary::compiled_scene_path("benchmark");
+    scene_binary::write_scene(output, ir, 0);
+    const float binary_ms = best_of(RUNS, [&] {
+        SceneIR read_ir;
+        scene_binary::read_scene(output, 0, read_ir);
+    });
+    fs::remove(output);
+
+    const auto per_entity = [&](float ms) { return ms * 1000.f / static_cast<float>(entity_count); };
+    LOG_INFO("Benchmark scene: {} entities, {} components, {} KiB of JSON", ir.entity_count, ir.records.size(),
+             text.size() / 1024);
+    LOG_INFO("JSON parse:        {:8.2f} ms ({:.2f} us/entity)", dom_ms, per_entity(dom_ms));
+    LOG_INFO("JSON to records:   {:8.2f} ms ({:.2f} us/entity)", parse_ms - dom_ms, per_entity(parse_ms - dom_ms));
+    LOG_INFO("JSON total:        {:8.2f} ms ({:.2f} us/entity)", parse_ms, per_entity(parse_ms));
+    LOG_INFO("Compiled file:     {:8.2f} ms ({:.2f} us/entity)", binary_ms, per_entity(binary_ms));
+    LOG_INFO("Checksum:          {}", checksum);
+    return EXIT_SUCCESS;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    raycast::logging::LogManager log_manager;
+    log_manager.Initialize();
+
+    if (argc > 1 && std::strcmp(argv[1], "--bench") == 0) {
+        const int result = bench(argc > 2 ? std::stoul(argv[2]) : 10000);
+        log_manager.ShutDown();
+        return result;
+    }
+
+    // scene tags are the file names, no matter which folder the scene is in
+    for (const auto& entry : fs::recursive_directory_iterator(scene_path(""))) {
+        if (entry.is_regular_file() && entry.path().extension() == ".json") {
+            compile_scene(entry.path());
+        }
+    }
+    for (const auto& entry : fs::directory_iterator(background_path(""))) {
+        if (entry.is_regular_file() && entry.path().extension() == ".json") {
+            compile_background(entry.path());
+        }
+    }
+
+    LOG_INFO("Compiled {} files, {} failed", compiled, failed);
+    log_manager.ShutDown();
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
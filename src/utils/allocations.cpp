@@ -0,0 +1,40 @@
+#include "allocations.hpp"
+
+#ifdef RAYCAST_COUNT_ALLOCATIONS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+std::atomic<size_t> allocation_count = 0;
+} // namespace
+
+// the array and nothrow forms of new and delete all forward to these
+void* operator new(const size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+size_t raycast::allocations::count() {
+    return allocation_count.load(std::memory_order_relaxed);
+}
+
+#else
+
+size_t raycast::allocations::count() {
+    return 0;
+}
+
+#endif
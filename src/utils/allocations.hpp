@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+
+namespace raycast {
+namespace allocations {
+/**
+ * Number of heap allocations made through the global `operator new` since the program started, by any thread.
+ * Only counted when built with the RAYCAST_COUNT_ALLOCATIONS CMake option, otherwise this is always 0.
+ */
+size_t count();
+} // namespace allocations
+} // namespace raycast
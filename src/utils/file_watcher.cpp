@@ -0,0 +1,160 @@
+#include "file_watcher.hpp"
+#include "logging/log.hpp"
+
+#include <algorithm>
+#include <cerrno>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+
+namespace {
+    constexpr uint32_t WATCH_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE;
+}
+
+FileWatcher::FileWatcher() {
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0 || pipe2(wake_pipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+        LOG_ERROR("Failed to set up inotify, hot reloading is disabled");
+        return;
+    }
+    thread = std::thread(&FileWatcher::watchLoop, this);
+}
+
+FileWatcher::~FileWatcher() {
+    if (thread.joinable()) {
+        // any byte on the pipe wakes the watcher thread up so it can exit
+        const char stop = 0;
+        (void)!write(wake_pipe[1], &stop, 1);
+        thread.join();
+    }
+    for (const int fd : {inotify_fd, wake_pipe[0], wake_pipe[1]}) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+bool FileWatcher::watch(const std::filesystem::path& directory) {
+    if (inotify_fd < 0) {
+        return false;
+    }
+
+    const int wd = inotify_add_watch(inotify_fd, directory.c_str(), WATCH_EVENTS);
+    if (wd < 0) {
+        LOG_WARN("Failed to watch directory '{}'", directory.string());
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    watch_directories[wd] = directory;
+    return true;
+}
+
+void FileWatcher::watchLoop() {
+    // large enough for a burst of events, and aligned the way the kernel expects
+    alignas(inotify_event) char buffer[16 * 1024];
+    pollfd fds[2] = {{inotify_fd, POLLIN, 0}, {wake_pipe[0], POLLIN, 0}};
+
+    while (true) {
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            LOG_ERROR("Failed to wait for file changes, hot reloading is disabled");
+            return;
+        }
+        if (fds[1].revents != 0) {
+            return;
+        }
+
+        ssize_t length;
+        while ((length = read(inotify_fd, buffer, sizeof(buffer))) > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (ssize_t offset = 0; offset < length;) {
+                const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+                offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+                const auto directory = watch_directories.find(event->wd);
+                if (event->len == 0 || directory == watch_directories.end()) {
+                    continue;
+                }
+                changes.push_back(directory->second / event->name);
+            }
+            has_changes.store(!changes.empty(), std::memory_order_release);
+        }
+    }
+}
+
+#else
+
+FileWatcher::FileWatcher() = default;
+
+FileWatcher::~FileWatcher() = default;
+
+bool FileWatcher::watch(const std::filesystem::path& directory) {
+    std::error_code error;
+    WatchedDirectory& watched_directory = watched[directory.string()];
+    watched_directory.write_time = std::filesystem::last_write_time(directory, error);
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        watched_directory.file_write_times[entry.path().filename().string()] = entry.last_write_time();
+    }
+    return !error;
+}
+
+void FileWatcher::scan() {
+    std::vector<std::filesystem::path> changed;
+    for (auto& [directory, watched_directory] : watched) {
+        std::error_code error;
+        const auto write_time = std::filesystem::last_write_time(directory, error);
+        if (error || write_time == watched_directory.write_time) {
+            continue;
+        }
+        watched_directory.write_time = write_time;
+
+        for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+            auto& file_write_time = watched_directory.file_write_times[entry.path().filename().string()];
+            if (entry.last_write_time() > file_write_time) {
+                file_write_time = entry.last_write_time();
+                changed.push_back(entry.path());
+            }
+        }
+    }
+
+    if (!changed.empty()) {
+        std::lock_guard<std::mutex> lock(mutex);
+        changes.insert(changes.end(), changed.begin(), changed.end());
+        has_changes.store(true, std::memory_order_release);
+    }
+}
+
+#endif
+
+std::vector<std::filesystem::path> FileWatcher::poll() {
+#ifndef __linux__
+    if (raycast::time::ms_since(last_scan) > POLL_INTERVAL_MS) {
+        last_scan = raycast::time::Clock::now();
+        scan();
+    }
+#endif
+
+    std::vector<std::filesystem::path> changed;
+    if (!has_changes.load(std::memory_order_acquire)) {
+        return changed;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        changed.swap(changes);
+        has_changes.store(false, std::memory_order_relaxed);
+    }
+
+    // editors tend to produce several events per save
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+    return changed;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "time.hpp"
+
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Watches directories for files that are written, created, moved or deleted, and hands the changed paths to the
+ * main thread.
+ *
+ * On Linux this uses inotify: a background thread blocks on the inotify descriptor and queues up changes, so `poll`
+ * is a single atomic load while nothing happened. Elsewhere (Emscripten, macOS, Windows) `poll` falls back to
+ * comparing write times of the watched directories every `POLL_INTERVAL_MS`.
+ */
+class FileWatcher {
+    static constexpr float POLL_INTERVAL_MS = 1000.f;
+
+    std::mutex mutex;
+    std::vector<std::filesystem::path> changes;
+    std::atomic<bool> has_changes = false;
+
+#ifdef __linux__
+    int inotify_fd = -1;
+    int wake_pipe[2] = {-1, -1};
+    std::unordered_map<int, std::filesystem::path> watch_directories;
+    std::thread thread;
+
+    void watchLoop();
+#else
+    struct WatchedDirectory {
+        std::filesystem::file_time_type write_time;
+        std::unordered_map<std::string, std::filesystem::file_time_type> file_write_times;
+    };
+
+    std::unordered_map<std::string, WatchedDirectory> watched;
+    raycast::time::Clock::time_point last_scan = raycast::time::Clock::now();
+
+    void scan();
+#endif
+
+  public:
+    FileWatcher();
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+    ~FileWatcher();
+
+    /**
+     * Start watching the files directly inside the given directory (not recursive).
+     * @return whether the directory could be watched
+     */
+    bool watch(const std::filesystem::path& directory);
+
+    /**
+     * Take the paths that changed since the last call, without duplicates. Should be called from the main thread.
+     */
+    std::vector<std::filesystem::path> poll();
+};
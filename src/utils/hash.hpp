@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+namespace raycast {
+namespace hash {
+constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+/**
+ * 64-bit FNV-1a hash. Not cryptographic, but fast and good enough to detect changed files.
+ * Pass the result of a previous call as `hash` to hash several pieces of data together.
+ */
+inline uint64_t fnv1a(const void* data, const size_t size, uint64_t hash = FNV_OFFSET_BASIS) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+inline uint64_t fnv1a(const std::string_view string, const uint64_t hash = FNV_OFFSET_BASIS) {
+    return fnv1a(string.data(), string.size(), hash);
+}
+
+/**
+ * Hash the bytes of a plain value, e.g. a number or a glm vector. Beware of padding bytes in structs.
+ */
+template <typename T> uint64_t fnv1aValue(const T& value, const uint64_t hash = FNV_OFFSET_BASIS) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    return fnv1a(&value, sizeof(T), hash);
+}
+} // namespace hash
+} // namespace raycast
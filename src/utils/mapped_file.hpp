@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Read-only view of a whole file.
+ *
+ * On POSIX systems the file is memory-mapped, so its contents are paged in on demand and never copied.
+ * Elsewhere (Windows, Emscripten's virtual file system) the file is read into an owned buffer instead.
+ */
+class MappedFile {
+    const uint8_t* bytes = nullptr;
+    size_t length = 0;
+    bool mapped = false;
+    std::vector<uint8_t> buffer;
+
+  public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    /**
+     * Open and map the given file, replacing any file that was previously opened.
+     *
+     * @return whether the file could be opened.
+     */
+    bool open(const std::string& path);
+
+    void close();
+
+    [[nodiscard]] const uint8_t* data() const { return bytes; }
+
+    [[nodiscard]] size_t size() const { return length; }
+};
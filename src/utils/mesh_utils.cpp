@@ -1,15 +1,157 @@
 #include "mesh_utils.hpp"
+#include "logging/log.hpp"
+#include "mapped_file.hpp"
+#include "utils/hash.hpp"
 
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 
+namespace {
+/**
+ * Header of a compiled mesh file. It is followed by `vertex_count` `ColoredVertex`s and `index_count` uint16 indices,
+ * so the whole file can be copied straight into a `MeshData` without any parsing.
+ */
+struct MeshFileHeader {
+    char magic[4];
+    uint32_t version;
+    int64_t source_write_time;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    vec2 size;
+};
+
+constexpr char MESH_FILE_MAGIC[4] = {'R', 'M', 'S', 'H'};
+constexpr uint32_t MESH_FILE_VERSION = 1;
+
+// Meshes are cached under their path relative to the data folder, e.g. ./data/meshes/mirror.obj ->
+// cache/meshes/meshes/mirror.rmesh, so meshes with the same name in different folders get cache files of their own.
+// Meshes outside of the data folder are cached under a hash of their path.
+std::string compiled_mesh_path(const std::string& obj_path) {
+    const std::filesystem::path path = std::filesystem::path(obj_path).lexically_normal();
+    std::filesystem::path relative = path.lexically_relative(std::filesystem::path(data_path()).lexically_normal());
+    if (relative.empty() || *relative.begin() == "..") {
+        relative = std::to_string(raycast::hash::fnv1a(path.generic_string())) + path.extension().string();
+    }
+    return cache_path("meshes/" + relative.replace_extension(".rmesh").generic_string());
+}
+
+int64_t source_write_time(const std::string& path) {
+    std::error_code error;
+    const auto time = std::filesystem::last_write_time(path, error);
+    return error ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+}
+
+float elapsed_ms(std::chrono::steady_clock::time_point start) {
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<float>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()) / 1000.f;
+}
+} // namespace
+
+const MeshData* MeshUtils::load(const std::string& obj_path) {
+    const auto start = std::chrono::steady_clock::now();
+
+    auto it = cache.find(obj_path);
+    if (it != cache.end()) {
+        return &it->second;
+    }
+
+    MeshData mesh;
+    const char* source = "compiled mesh";
+    const int64_t write_time = source_write_time(obj_path);
+    const std::string binary_path = compiled_mesh_path(obj_path);
+
+    if (!loadFromBinaryFile(binary_path, write_time, mesh)) {
+        if (!parseOBJFile(obj_path, mesh.vertices, mesh.vertex_indices, mesh.size)) {
+            return nullptr;
+        }
+        writeBinaryFile(binary_path, write_time, mesh);
+        source = "OBJ";
+    }
+
+    LOG_INFO("Loaded mesh {} from {} in {:.3f} ms", obj_path, source, elapsed_ms(start));
+    return &cache.emplace(obj_path, std::move(mesh)).first->second;
+}
+
 bool MeshUtils::loadFromOBJFile(const std::string& obj_path, std::vector<ColoredVertex>& out_vertices,
-                     std::vector<uint16_t>& out_vertex_indices, vec2& out_size) {
+                                std::vector<uint16_t>& out_vertex_indices, vec2& out_size) {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    const MeshData* mesh = load(obj_path);
+    if (mesh == nullptr) {
+        return false;
+    }
+
+    out_vertices = mesh->vertices;
+    out_vertex_indices = mesh->vertex_indices;
+    out_size = mesh->size;
+    return true;
+}
+
+bool MeshUtils::preload(const std::string& obj_path) {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    return load(obj_path) != nullptr;
+}
+
+bool MeshUtils::loadFromBinaryFile(const std::string& binary_path, const int64_t source_write_time, MeshData& out_mesh) {
+    MappedFile file;
+    if (!file.open(binary_path) || file.size() < sizeof(MeshFileHeader)) {
+        return false;
+    }
+
+    MeshFileHeader header{};
+    std::memcpy(&header, file.data(), sizeof(header));
+    const size_t vertices_size = sizeof(ColoredVertex) * header.vertex_count;
+    const size_t indices_size = sizeof(uint16_t) * header.index_count;
+
+    // the source OBJ was edited since this file was written, or the file is from an incompatible build
+    if (std::memcmp(header.magic, MESH_FILE_MAGIC, sizeof(MESH_FILE_MAGIC)) != 0 || header.version != MESH_FILE_VERSION ||
+        header.source_write_time != source_write_time || file.size() != sizeof(header) + vertices_size + indices_size) {
+        return false;
+    }
+
+    const uint8_t* vertices = file.data() + sizeof(header);
+    out_mesh.vertices.resize(header.vertex_count);
+    std::memcpy(out_mesh.vertices.data(), vertices, vertices_size);
+    out_mesh.vertex_indices.resize(header.index_count);
+    std::memcpy(out_mesh.vertex_indices.data(), vertices + vertices_size, indices_size);
+    out_mesh.size = header.size;
+    return true;
+}
+
+void MeshUtils::writeBinaryFile(const std::string& binary_path, const int64_t source_write_time, const MeshData& mesh) {
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(binary_path).parent_path(), error);
+
+    std::ofstream file(binary_path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        LOG_WARN("Could not write compiled mesh {}", binary_path);
+        return;
+    }
+
+    MeshFileHeader header{};
+    std::memcpy(header.magic, MESH_FILE_MAGIC, sizeof(MESH_FILE_MAGIC));
+    header.version = MESH_FILE_VERSION;
+    header.source_write_time = source_write_time;
+    header.vertex_count = static_cast<uint32_t>(mesh.vertices.size());
+    header.index_count = static_cast<uint32_t>(mesh.vertex_indices.size());
+    header.size = mesh.size;
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(mesh.vertices.data()),
+               static_cast<std::streamsize>(sizeof(ColoredVertex) * mesh.vertices.size()));
+    file.write(reinterpret_cast<const char*>(mesh.vertex_indices.data()),
+               static_cast<std::streamsize>(sizeof(uint16_t) * mesh.vertex_indices.size()));
+}
+
+bool MeshUtils::parseOBJFile(const std::string& obj_path, std::vector<ColoredVertex>& out_vertices,
+                             std::vector<uint16_t>& out_vertex_indices, vec2& out_size) {
     // disable warnings about fscanf and fopen on Windows
 #ifdef _MSC_VER
 #pragma warning(disable : 4996)
 #endif
 
-    printf("Loading OBJ file %s...\n", obj_path.c_str());
     // Note, normal and UV indices are not loaded/used, but code is commented to do so
     std::vector<uint16_t> out_uv_indices, out_normal_indices;
     std::vector<glm::vec2> out_uvs;
@@ -4,8 +4,56 @@
 #include "mesh_utils.hpp"
 #include "stages/mesh.hpp"
 
+#include <mutex>
+#include <unordered_map>
+
+/**
+ * Geometry of a mesh asset, normalized to the range -0.5 ... 0.5.
+ */
+struct MeshData {
+    std::vector<ColoredVertex> vertices;
+    std::vector<uint16_t> vertex_indices;
+    vec2 size = {1, 1};
+};
+
 class MeshUtils {
+    /**
+     * Meshes that have already been loaded, keyed by the path of their OBJ file.
+     */
+    inline static std::unordered_map<std::string, MeshData> cache;
+
+    /**
+     * Guards `cache`, meshes are also loaded ahead of time on the scene prefetch thread.
+     */
+    inline static std::mutex cache_mutex;
+
+    /**
+     * Get a mesh from the cache, loading it first if needed. Must be called with `cache_mutex` held.
+     * @return the cached mesh, or nullptr if it could not be loaded
+     */
+    static const MeshData* load(const std::string& obj_path);
+
+    static bool parseOBJFile(const std::string& obj_path, std::vector<ColoredVertex>& out_vertices,
+                             std::vector<uint16_t>& out_vertex_indices, vec2& out_size);
+
+    static bool loadFromBinaryFile(const std::string& binary_path, int64_t source_write_time, MeshData& out_mesh);
+
+    static void writeBinaryFile(const std::string& binary_path, int64_t source_write_time, const MeshData& mesh);
+
 public:
+    /**
+     * Load a mesh from an OBJ file.
+     *
+     * Each mesh is only loaded once and then served from memory. The first time an OBJ file is parsed, it is also
+     * converted into a compact binary file in the cache directory, which later runs memory-map instead of parsing
+     * the OBJ again (until the OBJ file is modified).
+     */
     static bool loadFromOBJFile(const std::string& obj_path, std::vector<ColoredVertex>& out_vertices,
                          std::vector<uint16_t>& out_vertex_indices, vec2& out_size);
+
+    /**
+     * Load a mesh into memory without copying it out, so a later `loadFromOBJFile` doesn't have to wait for the
+     * file. Safe to call from any thread.
+     */
+    static bool preload(const std::string& obj_path);
 };
@@ -0,0 +1,100 @@
+#include "png.hpp"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <vector>
+
+namespace {
+std::array<uint32_t, 256> make_crc_table() {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 1 ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+uint32_t crc32(const uint8_t* data, const size_t size, uint32_t crc) {
+    static const std::array<uint32_t, 256> table = make_crc_table();
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+void put_u32(std::vector<uint8_t>& out, const uint32_t value) {
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+void write_chunk(std::ofstream& file, const char type[4], const std::vector<uint8_t>& data) {
+    std::vector<uint8_t> chunk;
+    chunk.reserve(data.size() + 12);
+    put_u32(chunk, static_cast<uint32_t>(data.size()));
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    // the checksum covers the type and the data
+    put_u32(chunk, crc32(chunk.data() + 4, chunk.size() - 4, 0xFFFFFFFFu) ^ 0xFFFFFFFFu);
+    file.write(reinterpret_cast<const char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+}
+} // namespace
+
+bool raycast::png::write(const std::filesystem::path& path, const int width, const int height, const uint8_t* pixels) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    static const uint8_t SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    file.write(reinterpret_cast<const char*>(SIGNATURE), sizeof(SIGNATURE));
+
+    std::vector<uint8_t> header;
+    put_u32(header, static_cast<uint32_t>(width));
+    put_u32(header, static_cast<uint32_t>(height));
+    // 8 bits per channel, RGBA, default compression, filtering and no interlacing
+    header.insert(header.end(), {8, 6, 0, 0, 0});
+    write_chunk(file, "IHDR", header);
+
+    // every row starts with its filter type (none), the rows are then stored in deflate blocks of at most 64 KiB
+    const size_t row_size = static_cast<size_t>(width) * 4;
+    std::vector<uint8_t> filtered;
+    filtered.reserve((row_size + 1) * height);
+    for (int y = 0; y < height; y++) {
+        filtered.push_back(0);
+        filtered.insert(filtered.end(), pixels + y * row_size, pixels + (y + 1) * row_size);
+    }
+
+    constexpr size_t MAX_BLOCK_SIZE = 0xFFFF;
+    std::vector<uint8_t> compressed = {0x78, 0x01};
+    compressed.reserve(filtered.size() + filtered.size() / MAX_BLOCK_SIZE * 5 + 16);
+    size_t offset = 0;
+    do {
+        const size_t block_size = std::min(MAX_BLOCK_SIZE, filtered.size() - offset);
+        const bool last_block = offset + block_size == filtered.size();
+        compressed.push_back(last_block ? 1 : 0);
+        compressed.push_back(static_cast<uint8_t>(block_size));
+        compressed.push_back(static_cast<uint8_t>(block_size >> 8));
+        compressed.push_back(static_cast<uint8_t>(~block_size));
+        compressed.push_back(static_cast<uint8_t>(~block_size >> 8));
+        compressed.insert(compressed.end(), filtered.begin() + offset, filtered.begin() + offset + block_size);
+        offset += block_size;
+    } while (offset < filtered.size());
+
+    uint32_t adler_a = 1;
+    uint32_t adler_b = 0;
+    for (const uint8_t byte : filtered) {
+        adler_a = (adler_a + byte) % 65521;
+        adler_b = (adler_b + adler_a) % 65521;
+    }
+    put_u32(compressed, (adler_b << 16) | adler_a);
+    write_chunk(file, "IDAT", compressed);
+
+    write_chunk(file, "IEND", {});
+    return static_cast<bool>(file);
+}
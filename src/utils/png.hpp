@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+namespace raycast {
+namespace png {
+/**
+ * Write 8-bit RGBA pixels to a PNG file. The image data is stored without compression, which keeps the writer
+ * tiny; it is meant for frame captures, not for shipping assets.
+ *
+ * @param pixels `width * height` RGBA pixels, row by row starting from the top
+ * @return whether the file could be written
+ */
+bool write(const std::filesystem::path& path, int width, int height, const uint8_t* pixels);
+} // namespace png
+} // namespace raycast
@@ -0,0 +1,55 @@
+#include "thread_pool.hpp"
+
+
+ThreadPool::ThreadPool(unsigned int thread_count) {
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+    if (thread_count == 0) {
+        // hardware_concurrency may return 0 when it can't tell
+        const unsigned int hw = std::thread::hardware_concurrency();
+        thread_count = hw > 1 ? hw - 1 : 1;
+    }
+    for (unsigned int i = 0; i < thread_count; i++) {
+        workers.emplace_back(&ThreadPool::work, this);
+    }
+#endif
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobs_available.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> job) {
+    if (workers.empty()) {
+        job();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    jobs_available.notify_one();
+}
+
+void ThreadPool::work() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobs_available.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) {
+                return; // stopping and nothing left to do
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of worker threads that run submitted jobs in FIFO order.
+ *
+ * Jobs must not touch OpenGL or the ECS registry; hand results back to the main thread instead.
+ * On Emscripten (built without pthreads) there are no workers and jobs run immediately inside `submit`.
+ */
+class ThreadPool {
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable jobs_available;
+    bool stopping = false;
+
+    void work();
+
+  public:
+    /**
+     * @param thread_count Number of worker threads, 0 picks one less than the number of hardware threads
+     */
+    explicit ThreadPool(unsigned int thread_count = 0);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * Finishes all queued jobs before joining the workers.
+     */
+    ~ThreadPool();
+
+    void submit(std::function<void()> job);
+};
@@ -1,5 +1,24 @@
+#pragma once
+
+#include <chrono>
+
 namespace raycast {
   namespace time {
     const float ONE_SECOND_IN_MS = 1000.f;
+
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * Roughly the time the process started at (it is set during static initialization, before `main` runs).
+     */
+    inline const Clock::time_point process_start = Clock::now();
+
+    /**
+     * Milliseconds elapsed since the given time point.
+     */
+    inline float ms_since(const Clock::time_point start) {
+      const auto elapsed = Clock::now() - start;
+      return static_cast<float>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()) / ONE_SECOND_IN_MS;
+    }
   }
 }
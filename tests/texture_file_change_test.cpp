@@ -0,0 +1,40 @@
+#include "texture.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+int failures = 0;
+
+void expect(const bool condition, const char* what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAILED: %s\n", what);
+        failures++;
+    }
+}
+} // namespace
+
+int main() {
+    TextureFileChange change;
+
+    // paths as the file watcher reports them, the watched folder joined with the file name
+    expect(textureFileChange(std::filesystem::path(textures_path("albedo")) / "mirror.png", change),
+           "changed albedo texture is picked up");
+    expect(change.name == "mirror" && !change.is_normal, "albedo texture name");
+
+    expect(textureFileChange(std::filesystem::path(textures_path("normal")) / "mirror_n.png", change),
+           "changed normal map is picked up");
+    expect(change.name == "mirror_n" && change.is_normal, "normal map name");
+
+    expect(textureFileChange(std::filesystem::path(data_path() + "/./textures/albedo/") / "mirror.png", change),
+           "folder is compared after normalizing it");
+
+    expect(!textureFileChange(std::filesystem::path(textures_path("")) / "mirror.png", change),
+           "files outside of the texture folders are ignored");
+    expect(!textureFileChange(std::filesystem::path(shader_path("textured.fs.glsl")), change),
+           "shaders are ignored");
+    expect(!textureFileChange(std::filesystem::path(textures_path("albedo")) / "mirror.png~", change),
+           "editor backups are ignored");
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}